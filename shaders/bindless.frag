@@ -0,0 +1,28 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterial;
+layout(location = 3) flat in uint fragTexture;
+layout(location = 4) flat in uint fragSampler;
+
+// the texture table, registered once and indexed per instance
+layout(set = 1, binding = 0) uniform texture2D textures[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+
+layout(location = 0) out vec4 outColor;
+
+// INSTANCE_MATERIAL_COUNT tints, material 0 leaves the texture untouched
+const vec3 materialTints[4] = vec3[](
+    vec3(1.0, 1.0, 1.0),
+    vec3(1.0, 0.6, 0.6),
+    vec3(0.6, 1.0, 0.6),
+    vec3(0.6, 0.6, 1.0)
+);
+
+void main()
+{
+    vec4 texel = texture(sampler2D(textures[nonuniformEXT(fragTexture)], samplers[nonuniformEXT(fragSampler)]), fragTexCoord);
+    outColor = texel * vec4(materialTints[fragMaterial % 4u], 1.0);
+}
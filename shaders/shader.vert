@@ -1,21 +1,39 @@
 #version 450
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
 
-layout(location = 0) in vec2 inPosition;
+struct InstanceData {
+    mat4 model;
+    uint material;
+    uint textureIndex;
+    uint samplerIndex;
+};
+
+layout(std430, binding = 2) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial;
+layout(location = 3) flat out uint fragTexture;
+layout(location = 4) flat out uint fragSampler;
 
 void main()
 {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+    InstanceData instance = instances[gl_InstanceIndex];
+
+    gl_Position = ubo.proj * ubo.view * instance.model * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
-}
\ No newline at end of file
+    fragMaterial = instance.material;
+    fragTexture = instance.textureIndex;
+    fragSampler = instance.samplerIndex;
+}
@@ -0,0 +1,392 @@
+#include "allocator.h"
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+void memory_allocator_create(memory_allocator* allocator, VkPhysicalDevice physical_device, VkDevice device)
+{
+    memset(allocator, 0, sizeof(memory_allocator));
+
+    allocator->device = device;
+
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &allocator->memory_properties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    allocator->non_coherent_atom_size = properties.limits.nonCoherentAtomSize;
+    allocator->max_allocation_count = properties.limits.maxMemoryAllocationCount;
+}
+
+static void free_block(memory_allocator* allocator, memory_block* block)
+{
+    if (block->mapped) {
+        vkUnmapMemory(allocator->device, block->memory);
+    }
+
+    vkFreeMemory(allocator->device, block->memory, NULL);
+    free(block->free_ranges);
+
+    memset(block, 0, sizeof(memory_block));
+
+    allocator->device_allocation_count -= 1;
+}
+
+void memory_allocator_destroy(memory_allocator* allocator)
+{
+    for (u32 type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+        for (u32 kind = 0; kind < MEMORY_RESOURCE_KIND_COUNT; ++kind) {
+            memory_pool* pool = &allocator->pools[type][kind];
+
+            for (u32 i = 0; i < pool->block_count; ++i) {
+                if (pool->blocks[i].memory == VK_NULL_HANDLE) {
+                    continue;
+                }
+
+                if (pool->blocks[i].allocation_count > 0) {
+                    fprintf(stderr, "memory type %u block %u destroyed with %u live allocations\n", type, i, pool->blocks[i].allocation_count);
+                }
+
+                free_block(allocator, &pool->blocks[i]);
+            }
+
+            free(pool->blocks);
+            pool->blocks = NULL;
+            pool->block_count = 0;
+        }
+    }
+}
+
+u32 memory_allocator_find_type(const memory_allocator* allocator, u32 type_filter, VkMemoryPropertyFlags properties)
+{
+    for (u32 i = 0; i < allocator->memory_properties.memoryTypeCount; ++i) {
+        if (type_filter & (1 << i) && (allocator->memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    fprintf(stderr, "failed to find suitable memory type\n");
+
+    return UINT32_MAX;
+}
+
+static void insert_free_range(memory_block* block, u32 index, memory_range range)
+{
+    if (block->free_range_count == block->free_range_capacity) {
+        block->free_range_capacity = block->free_range_capacity ? block->free_range_capacity * 2 : 8;
+        block->free_ranges = (memory_range*)realloc(block->free_ranges, sizeof(memory_range) * block->free_range_capacity);
+    }
+
+    memmove(&block->free_ranges[index + 1], &block->free_ranges[index], sizeof(memory_range) * (block->free_range_count - index));
+    block->free_ranges[index] = range;
+    block->free_range_count += 1;
+}
+
+static void remove_free_range(memory_block* block, u32 index)
+{
+    memmove(&block->free_ranges[index], &block->free_ranges[index + 1], sizeof(memory_range) * (block->free_range_count - index - 1));
+    block->free_range_count -= 1;
+}
+
+// best fit over the offset sorted free list
+static bool block_alloc(memory_block* block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+    if (block->size - block->used < size) {
+        return false;
+    }
+
+    u32 best = UINT32_MAX;
+    VkDeviceSize best_waste = UINT64_MAX;
+
+    for (u32 i = 0; i < block->free_range_count; ++i) {
+        memory_range range = block->free_ranges[i];
+        VkDeviceSize aligned = align_up(range.offset, alignment);
+
+        if (aligned + size > range.offset + range.size) {
+            continue;
+        }
+
+        VkDeviceSize waste = range.size - size;
+        if (waste < best_waste) {
+            best = i;
+            best_waste = waste;
+
+            if (waste == 0) {
+                break;
+            }
+        }
+    }
+
+    if (best == UINT32_MAX) {
+        return false;
+    }
+
+    memory_range range = block->free_ranges[best];
+    VkDeviceSize aligned = align_up(range.offset, alignment);
+    VkDeviceSize front = aligned - range.offset;
+    VkDeviceSize back = range.offset + range.size - (aligned + size);
+
+    remove_free_range(block, best);
+
+    u32 index = best;
+    if (front > 0) {
+        insert_free_range(block, index++, (memory_range){ range.offset, front });
+    }
+
+    if (back > 0) {
+        insert_free_range(block, index, (memory_range){ aligned + size, back });
+    }
+
+    block->used += size;
+    block->allocation_count += 1;
+
+    *offset = aligned;
+
+    return true;
+}
+
+static void block_free(memory_block* block, VkDeviceSize offset, VkDeviceSize size)
+{
+    u32 low = 0;
+    u32 high = block->free_range_count;
+
+    while (low < high) {
+        u32 middle = (low + high) / 2;
+        if (block->free_ranges[middle].offset < offset) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    u32 index = low;
+    memory_range range = { offset, size };
+
+    if (index > 0 && block->free_ranges[index - 1].offset + block->free_ranges[index - 1].size == offset) {
+        range.offset = block->free_ranges[index - 1].offset;
+        range.size += block->free_ranges[index - 1].size;
+        remove_free_range(block, --index);
+    }
+
+    if (index < block->free_range_count && offset + size == block->free_ranges[index].offset) {
+        range.size += block->free_ranges[index].size;
+        remove_free_range(block, index);
+    }
+
+    insert_free_range(block, index, range);
+
+    block->used -= size;
+    block->allocation_count -= 1;
+}
+
+static u32 create_block(memory_allocator* allocator, memory_pool* pool, u32 memory_type, VkDeviceSize size, bool dedicated)
+{
+    VkDeviceSize block_size = size;
+
+    if (!dedicated) {
+        VkDeviceSize heap_size = allocator->memory_properties.memoryHeaps[allocator->memory_properties.memoryTypes[memory_type].heapIndex].size;
+
+        block_size = MEMORY_BLOCK_SIZE;
+        if (block_size > heap_size / 8) {
+            block_size = heap_size / 8;
+        }
+        if (block_size < size) {
+            block_size = size;
+        }
+    }
+
+    if (allocator->device_allocation_count >= allocator->max_allocation_count) {
+        fprintf(stderr, "device memory allocation count limit (%u) reached\n", allocator->max_allocation_count);
+        return UINT32_MAX;
+    }
+
+    VkMemoryAllocateInfo allocate_info;
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.pNext = NULL;
+    allocate_info.allocationSize = block_size;
+    allocate_info.memoryTypeIndex = memory_type;
+
+    VkDeviceMemory memory;
+    while (vkAllocateMemory(allocator->device, &allocate_info, NULL, &memory) != VK_SUCCESS) {
+        if (allocate_info.allocationSize / 2 < size) {
+            fprintf(stderr, "failed to allocate %" PRIu64 " bytes of device memory\n", (u64)allocate_info.allocationSize);
+            return UINT32_MAX;
+        }
+
+        allocate_info.allocationSize /= 2;
+    }
+
+    u32 index = pool->block_count;
+    for (u32 i = 0; i < pool->block_count; ++i) {
+        if (pool->blocks[i].memory == VK_NULL_HANDLE) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index == pool->block_count) {
+        pool->blocks = (memory_block*)realloc(pool->blocks, sizeof(memory_block) * (pool->block_count + 1));
+        pool->block_count += 1;
+    }
+
+    memory_block* block = &pool->blocks[index];
+    memset(block, 0, sizeof(memory_block));
+
+    block->memory = memory;
+    block->size = allocate_info.allocationSize;
+    block->dedicated = dedicated;
+
+    insert_free_range(block, 0, (memory_range){ 0, block->size });
+
+    if (allocator->memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(allocator->device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+            fprintf(stderr, "failed to map memory block\n");
+            block->mapped = NULL;
+        }
+    }
+
+    allocator->device_allocation_count += 1;
+
+    return index;
+}
+
+bool memory_allocator_alloc(memory_allocator* allocator, const VkMemoryRequirements* requirements, VkMemoryPropertyFlags properties, memory_resource_kind kind, memory_allocation* allocation)
+{
+    memset(allocation, 0, sizeof(memory_allocation));
+
+    u32 memory_type = memory_allocator_find_type(allocator, requirements->memoryTypeBits, properties);
+    if (memory_type == UINT32_MAX) {
+        return false;
+    }
+
+    VkMemoryPropertyFlags type_flags = allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+
+    VkDeviceSize size = requirements->size;
+    VkDeviceSize alignment = requirements->alignment;
+
+    // non coherent ranges are flushed in whole atoms, so neighbours must not share one
+    if ((type_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(type_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        alignment = alignment > allocator->non_coherent_atom_size ? alignment : allocator->non_coherent_atom_size;
+        size = align_up(size, allocator->non_coherent_atom_size);
+    }
+
+    memory_pool* pool = &allocator->pools[memory_type][kind];
+    bool dedicated = size > MEMORY_BLOCK_SIZE / 2;
+
+    VkDeviceSize offset = 0;
+    u32 index = UINT32_MAX;
+
+    if (!dedicated) {
+        for (u32 i = 0; i < pool->block_count; ++i) {
+            if (pool->blocks[i].memory != VK_NULL_HANDLE && !pool->blocks[i].dedicated && block_alloc(&pool->blocks[i], size, alignment, &offset)) {
+                index = i;
+                break;
+            }
+        }
+    }
+
+    if (index == UINT32_MAX) {
+        index = create_block(allocator, pool, memory_type, size, dedicated);
+
+        if (index == UINT32_MAX || !block_alloc(&pool->blocks[index], size, alignment, &offset)) {
+            fprintf(stderr, "failed to sub allocate %" PRIu64 " bytes\n", (u64)size);
+            return false;
+        }
+    }
+
+    memory_block* block = &pool->blocks[index];
+
+    allocation->memory = block->memory;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->mapped = block->mapped ? (u8*)block->mapped + offset : NULL;
+    allocation->memory_type = memory_type;
+    allocation->block = index;
+    allocation->kind = kind;
+
+    return true;
+}
+
+void memory_allocator_free(memory_allocator* allocator, memory_allocation* allocation)
+{
+    if (allocation->memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    memory_pool* pool = &allocator->pools[allocation->memory_type][allocation->kind];
+    memory_block* block = &pool->blocks[allocation->block];
+
+    block_free(block, allocation->offset, allocation->size);
+
+    if (block->allocation_count == 0) {
+        // keep a single empty block per pool around to avoid allocation churn
+        bool other_block_alive = false;
+        for (u32 i = 0; i < pool->block_count; ++i) {
+            if (i != allocation->block && pool->blocks[i].memory != VK_NULL_HANDLE && !pool->blocks[i].dedicated) {
+                other_block_alive = true;
+                break;
+            }
+        }
+
+        if (block->dedicated || other_block_alive) {
+            free_block(allocator, block);
+        }
+    }
+
+    memset(allocation, 0, sizeof(memory_allocation));
+}
+
+void memory_allocator_print_stats(const memory_allocator* allocator, FILE* stream)
+{
+    fprintf(stream, "device memory allocations: %u / %u\n", allocator->device_allocation_count, allocator->max_allocation_count);
+
+    for (u32 type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+        for (u32 kind = 0; kind < MEMORY_RESOURCE_KIND_COUNT; ++kind) {
+            const memory_pool* pool = &allocator->pools[type][kind];
+
+            u32 block_count = 0;
+            u32 allocation_count = 0;
+            u32 free_range_count = 0;
+            VkDeviceSize total = 0;
+            VkDeviceSize used = 0;
+            VkDeviceSize largest_free = 0;
+
+            for (u32 i = 0; i < pool->block_count; ++i) {
+                const memory_block* block = &pool->blocks[i];
+
+                if (block->memory == VK_NULL_HANDLE) {
+                    continue;
+                }
+
+                block_count += 1;
+                allocation_count += block->allocation_count;
+                free_range_count += block->free_range_count;
+                total += block->size;
+                used += block->used;
+
+                for (u32 j = 0; j < block->free_range_count; ++j) {
+                    largest_free = block->free_ranges[j].size > largest_free ? block->free_ranges[j].size : largest_free;
+                }
+            }
+
+            if (block_count == 0) {
+                continue;
+            }
+
+            VkDeviceSize free_bytes = total - used;
+            f64 fragmentation = free_bytes > 0 ? (1.0 - (f64)largest_free / (f64)free_bytes) * 100.0 : 0.0;
+
+            fprintf(stream, "memory type %2u %-7s: %u blocks, %.2f / %.2f MiB used, %u allocations, %u free ranges, fragmentation %.1f%%\n",
+                type,
+                kind == MEMORY_RESOURCE_LINEAR ? "linear" : "optimal",
+                block_count,
+                (f64)used / (1024.0 * 1024.0),
+                (f64)total / (1024.0 * 1024.0),
+                allocation_count,
+                free_range_count,
+                fragmentation);
+        }
+    }
+}
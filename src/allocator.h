@@ -0,0 +1,67 @@
+#pragma once
+
+#include "defines.h"
+
+#include <volk.h>
+
+#define MEMORY_BLOCK_SIZE (64ull * 1024 * 1024)
+
+// buffers and linear images never share a block with optimal images, which keeps
+// every resource bufferImageGranularity apart from resources of the other kind
+typedef enum memory_resource_kind {
+    MEMORY_RESOURCE_LINEAR,
+    MEMORY_RESOURCE_OPTIMAL,
+    MEMORY_RESOURCE_KIND_COUNT
+} memory_resource_kind;
+
+typedef struct memory_range {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+} memory_range;
+
+typedef struct memory_block {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    VkDeviceSize used;
+    void* mapped;
+    u32 allocation_count;
+    memory_range* free_ranges;
+    u32 free_range_count;
+    u32 free_range_capacity;
+    bool dedicated;
+} memory_block;
+
+typedef struct memory_pool {
+    memory_block* blocks;
+    u32 block_count;
+} memory_pool;
+
+typedef struct memory_allocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* mapped;
+    u32 memory_type;
+    u32 block;
+    memory_resource_kind kind;
+} memory_allocation;
+
+typedef struct memory_allocator {
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize non_coherent_atom_size;
+    u32 max_allocation_count;
+    u32 device_allocation_count;
+    memory_pool pools[VK_MAX_MEMORY_TYPES][MEMORY_RESOURCE_KIND_COUNT];
+} memory_allocator;
+
+void memory_allocator_create(memory_allocator* allocator, VkPhysicalDevice physical_device, VkDevice device);
+void memory_allocator_destroy(memory_allocator* allocator);
+
+u32 memory_allocator_find_type(const memory_allocator* allocator, u32 type_filter, VkMemoryPropertyFlags properties);
+
+// host visible blocks stay mapped for their whole lifetime, allocation->mapped points at the sub range
+bool memory_allocator_alloc(memory_allocator* allocator, const VkMemoryRequirements* requirements, VkMemoryPropertyFlags properties, memory_resource_kind kind, memory_allocation* allocation);
+void memory_allocator_free(memory_allocator* allocator, memory_allocation* allocation);
+
+void memory_allocator_print_stats(const memory_allocator* allocator, FILE* stream);
@@ -0,0 +1,272 @@
+#include "cull.h"
+
+#if defined(__AVX__)
+#define CULL_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULL_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define CULL_NEON
+#include <arm_neon.h>
+#endif
+
+void cull_frustum_extract(cull_frustum* frustum, const f32 view_projection[16])
+{
+    // row r of the column-major matrix
+    const f32* m = view_projection;
+    f32 rows[4][4];
+    for (u32 r = 0; r < 4; ++r) {
+        for (u32 c = 0; c < 4; ++c) {
+            rows[r][c] = m[c * 4 + r];
+        }
+    }
+
+    // left, right, bottom, top, near (z >= 0), far (z <= w)
+    for (u32 c = 0; c < 4; ++c) {
+        frustum->planes[0][c] = rows[3][c] + rows[0][c];
+        frustum->planes[1][c] = rows[3][c] - rows[0][c];
+        frustum->planes[2][c] = rows[3][c] + rows[1][c];
+        frustum->planes[3][c] = rows[3][c] - rows[1][c];
+        frustum->planes[4][c] = rows[2][c];
+        frustum->planes[5][c] = rows[3][c] - rows[2][c];
+    }
+
+    // normalized so the sphere test can compare distances against radii
+    for (u32 p = 0; p < 6; ++p) {
+        f32* plane = frustum->planes[p];
+        f32 length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        f32 scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+        for (u32 c = 0; c < 4; ++c) {
+            plane[c] *= scale;
+        }
+    }
+}
+
+// the box corner furthest along the plane normal, picked once per plane for the whole batch
+typedef struct cull_corner {
+    const f32* x;
+    const f32* y;
+    const f32* z;
+} cull_corner;
+
+static cull_corner positive_corner(const scene_objects* objects, const f32 plane[4])
+{
+    cull_corner corner;
+    corner.x = plane[0] >= 0.0f ? objects->max_x : objects->min_x;
+    corner.y = plane[1] >= 0.0f ? objects->max_y : objects->min_y;
+    corner.z = plane[2] >= 0.0f ? objects->max_z : objects->min_z;
+
+    return corner;
+}
+
+// bit i of the result is set when object base + i is visible
+static u32 cull_batch_scalar(const scene_objects* objects, const cull_frustum* frustum, u32 base)
+{
+    u32 mask = (1u << SCENE_BATCH_SIZE) - 1;
+
+    for (u32 p = 0; p < 6; ++p) {
+        const f32* plane = frustum->planes[p];
+        cull_corner corner = positive_corner(objects, plane);
+
+        for (u32 i = 0; i < SCENE_BATCH_SIZE; ++i) {
+            u32 o = base + i;
+            f32 center = plane[0] * objects->center_x[o] + plane[1] * objects->center_y[o] + plane[2] * objects->center_z[o] + plane[3];
+            f32 box = plane[0] * corner.x[o] + plane[1] * corner.y[o] + plane[2] * corner.z[o] + plane[3];
+
+            if (center < -objects->radius[o] || box < 0.0f) {
+                mask &= ~(1u << i);
+            }
+        }
+    }
+
+    return mask;
+}
+
+#if defined(CULL_AVX)
+static u32 cull_batch_simd(const scene_objects* objects, const cull_frustum* frustum, u32 base)
+{
+    __m256 cx = _mm256_loadu_ps(objects->center_x + base);
+    __m256 cy = _mm256_loadu_ps(objects->center_y + base);
+    __m256 cz = _mm256_loadu_ps(objects->center_z + base);
+    __m256 negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(objects->radius + base));
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (u32 p = 0; p < 6; ++p) {
+        const f32* plane = frustum->planes[p];
+        cull_corner corner = positive_corner(objects, plane);
+
+        __m256 nx = _mm256_set1_ps(plane[0]);
+        __m256 ny = _mm256_set1_ps(plane[1]);
+        __m256 nz = _mm256_set1_ps(plane[2]);
+        __m256 nw = _mm256_set1_ps(plane[3]);
+
+        __m256 center = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, cx), _mm256_mul_ps(ny, cy)), _mm256_add_ps(_mm256_mul_ps(nz, cz), nw));
+        __m256 box = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(nx, _mm256_loadu_ps(corner.x + base)), _mm256_mul_ps(ny, _mm256_loadu_ps(corner.y + base))),
+            _mm256_add_ps(_mm256_mul_ps(nz, _mm256_loadu_ps(corner.z + base)), nw));
+
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(center, negative_radius, _CMP_GE_OQ));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(box, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+
+    return (u32)_mm256_movemask_ps(inside);
+}
+#elif defined(CULL_SSE2)
+static u32 cull_batch_simd(const scene_objects* objects, const cull_frustum* frustum, u32 base)
+{
+    u32 mask = 0;
+
+    // two halves of four lanes
+    for (u32 half = 0; half < SCENE_BATCH_SIZE; half += 4) {
+        u32 o = base + half;
+
+        __m128 cx = _mm_loadu_ps(objects->center_x + o);
+        __m128 cy = _mm_loadu_ps(objects->center_y + o);
+        __m128 cz = _mm_loadu_ps(objects->center_z + o);
+        __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(objects->radius + o));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (u32 p = 0; p < 6; ++p) {
+            const f32* plane = frustum->planes[p];
+            cull_corner corner = positive_corner(objects, plane);
+
+            __m128 nx = _mm_set1_ps(plane[0]);
+            __m128 ny = _mm_set1_ps(plane[1]);
+            __m128 nz = _mm_set1_ps(plane[2]);
+            __m128 nw = _mm_set1_ps(plane[3]);
+
+            __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), nw));
+            __m128 box = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(corner.x + o)), _mm_mul_ps(ny, _mm_loadu_ps(corner.y + o))),
+                _mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(corner.z + o)), nw));
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(center, negative_radius));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(box, _mm_setzero_ps()));
+        }
+
+        mask |= (u32)_mm_movemask_ps(inside) << half;
+    }
+
+    return mask;
+}
+#elif defined(CULL_NEON)
+static u32 cull_batch_simd(const scene_objects* objects, const cull_frustum* frustum, u32 base)
+{
+    static const u32 lane_bits[4] = {1, 2, 4, 8};
+    uint32x4_t bits = vld1q_u32(lane_bits);
+    u32 mask = 0;
+
+    for (u32 half = 0; half < SCENE_BATCH_SIZE; half += 4) {
+        u32 o = base + half;
+
+        float32x4_t cx = vld1q_f32(objects->center_x + o);
+        float32x4_t cy = vld1q_f32(objects->center_y + o);
+        float32x4_t cz = vld1q_f32(objects->center_z + o);
+        float32x4_t negative_radius = vnegq_f32(vld1q_f32(objects->radius + o));
+        uint32x4_t inside = vdupq_n_u32(UINT32_MAX);
+
+        for (u32 p = 0; p < 6; ++p) {
+            const f32* plane = frustum->planes[p];
+            cull_corner corner = positive_corner(objects, plane);
+
+            float32x4_t center = vdupq_n_f32(plane[3]);
+            center = vfmaq_n_f32(center, cx, plane[0]);
+            center = vfmaq_n_f32(center, cy, plane[1]);
+            center = vfmaq_n_f32(center, cz, plane[2]);
+
+            float32x4_t box = vdupq_n_f32(plane[3]);
+            box = vfmaq_n_f32(box, vld1q_f32(corner.x + o), plane[0]);
+            box = vfmaq_n_f32(box, vld1q_f32(corner.y + o), plane[1]);
+            box = vfmaq_n_f32(box, vld1q_f32(corner.z + o), plane[2]);
+
+            inside = vandq_u32(inside, vcgeq_f32(center, negative_radius));
+            inside = vandq_u32(inside, vcgezq_f32(box));
+        }
+
+        mask |= vaddvq_u32(vandq_u32(inside, bits)) << half;
+    }
+
+    return mask;
+}
+#else
+#define cull_batch_simd cull_batch_scalar
+#endif
+
+// branchless compaction, every lane is written and the count only advances for visible ones
+static u32 compact_batch(u32 mask, u32 base, u32* visible, u32 count)
+{
+    for (u32 i = 0; i < SCENE_BATCH_SIZE; ++i) {
+        visible[count] = base + i;
+        count += (mask >> i) & 1;
+    }
+
+    return count;
+}
+
+static u32 cull_tail(u32 mask, u32 base, u32 object_count, u32* visible, u32 count)
+{
+    mask &= (1u << (object_count - base)) - 1;
+
+    // the last batch may not have room for all lanes in visible
+    while (mask) {
+        u32 i = 0;
+        while (!((mask >> i) & 1)) {
+            ++i;
+        }
+
+        visible[count++] = base + i;
+        mask &= mask - 1;
+    }
+
+    return count;
+}
+
+u32 cull_objects(const scene_objects* objects, const cull_frustum* frustum, u32* visible)
+{
+    u32 count = 0;
+    u32 full = objects->count / SCENE_BATCH_SIZE * SCENE_BATCH_SIZE;
+
+    for (u32 base = 0; base < full; base += SCENE_BATCH_SIZE) {
+        u32 mask = cull_batch_simd(objects, frustum, base);
+
+        // index base + 7 is always below count here, so the speculative writes stay in bounds
+        count = compact_batch(mask, base, visible, count);
+    }
+
+    if (full < objects->count) {
+        count = cull_tail(cull_batch_simd(objects, frustum, full), full, objects->count, visible, count);
+    }
+
+    return count;
+}
+
+u32 cull_objects_scalar(const scene_objects* objects, const cull_frustum* frustum, u32* visible)
+{
+    u32 count = 0;
+    u32 full = objects->count / SCENE_BATCH_SIZE * SCENE_BATCH_SIZE;
+
+    for (u32 base = 0; base < full; base += SCENE_BATCH_SIZE) {
+        count = compact_batch(cull_batch_scalar(objects, frustum, base), base, visible, count);
+    }
+
+    if (full < objects->count) {
+        count = cull_tail(cull_batch_scalar(objects, frustum, full), full, objects->count, visible, count);
+    }
+
+    return count;
+}
+
+const char* cull_simd_name(void)
+{
+#if defined(CULL_AVX)
+    return "avx";
+#elif defined(CULL_SSE2)
+    return "sse2";
+#elif defined(CULL_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "defines.h"
+#include "scene.h"
+
+// inward facing planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+typedef struct cull_frustum {
+    f32 planes[6][4];
+} cull_frustum;
+
+// column-major projection * view with vulkan's [0, 1] clip depth
+void cull_frustum_extract(cull_frustum* frustum, const f32 view_projection[16]);
+
+// writes the indices of the objects whose sphere and box both touch the frustum, in ascending order,
+// and returns how many there are. visible needs room for objects->count indices
+u32 cull_objects(const scene_objects* objects, const cull_frustum* frustum, u32* visible);
+u32 cull_objects_scalar(const scene_objects* objects, const cull_frustum* frustum, u32* visible);
+
+// instruction set cull_objects was built for
+const char* cull_simd_name(void);
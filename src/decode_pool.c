@@ -0,0 +1,106 @@
+#include "decode_pool.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+u32 decode_pool_default_thread_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long cores = (long)info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return cores > 1 ? (u32)(cores - 1) : 1;
+}
+
+static int decode_worker(void* arg)
+{
+    decode_pool* pool = (decode_pool*)arg;
+
+    for (;;) {
+        u32 index = atomic_fetch_add_explicit(&pool->next_job, 1, memory_order_relaxed);
+        if (index >= pool->job_count) {
+            break;
+        }
+
+        // the slot for index is free once the consumer has popped index - DECODE_QUEUE_CAPACITY
+        while (index >= atomic_load_explicit(&pool->consumed, memory_order_acquire) + DECODE_QUEUE_CAPACITY) {
+            thrd_yield();
+        }
+
+        decode_job* job = &pool->jobs[index];
+        job->succeeded = job->decode(job->item, job->context);
+
+        atomic_store_explicit(&pool->ready[index % DECODE_QUEUE_CAPACITY], index + 1, memory_order_release);
+    }
+
+    return 0;
+}
+
+void decode_pool_start(decode_pool* pool, decode_job* jobs, u32 job_count, u32 thread_count)
+{
+    pool->jobs = jobs;
+    pool->job_count = job_count;
+    pool->thread_count = 0;
+
+    atomic_init(&pool->next_job, 0);
+    atomic_init(&pool->consumed, 0);
+    for (u32 i = 0; i < DECODE_QUEUE_CAPACITY; ++i) {
+        atomic_init(&pool->ready[i], 0);
+    }
+
+    thread_count = thread_count < job_count ? thread_count : job_count;
+    pool->threads = thread_count > 0 ? (thrd_t*)calloc(thread_count, sizeof(thrd_t)) : NULL;
+
+    for (u32 i = 0; i < thread_count; ++i) {
+        if (thrd_create(&pool->threads[pool->thread_count], decode_worker, pool) != thrd_success) {
+            fprintf(stderr, "failed to create decode thread\n");
+            break;
+        }
+
+        pool->thread_count += 1;
+    }
+}
+
+decode_job* decode_pool_pop(decode_pool* pool)
+{
+    u32 index = atomic_load_explicit(&pool->consumed, memory_order_relaxed);
+    if (index >= pool->job_count) {
+        return NULL;
+    }
+
+    decode_job* job = &pool->jobs[index];
+
+    if (pool->thread_count == 0) {
+        job->succeeded = job->decode(job->item, job->context);
+    } else {
+        while (atomic_load_explicit(&pool->ready[index % DECODE_QUEUE_CAPACITY], memory_order_acquire) != index + 1) {
+            thrd_yield();
+        }
+    }
+
+    atomic_store_explicit(&pool->consumed, index + 1, memory_order_release);
+
+    return job;
+}
+
+void decode_pool_join(decode_pool* pool)
+{
+    // unpopped jobs would keep workers waiting for queue space
+    while (decode_pool_pop(pool)) {
+    }
+
+    for (u32 i = 0; i < pool->thread_count; ++i) {
+        thrd_join(pool->threads[i], NULL);
+    }
+
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->thread_count = 0;
+}
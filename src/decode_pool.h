@@ -0,0 +1,38 @@
+#pragma once
+
+#include "defines.h"
+
+// how many decoded results may wait for the consumer before workers stall
+#define DECODE_QUEUE_CAPACITY 8
+
+typedef bool (*decode_fn)(void* item, void* context);
+
+typedef struct decode_job {
+    decode_fn decode;
+    void* item;
+    void* context;
+    bool succeeded;
+} decode_job;
+
+// workers claim jobs in submission order and publish them through a ring of sequence numbers,
+// the single consumer pops them back in the same order
+typedef struct decode_pool {
+    thrd_t* threads;
+    u32 thread_count;
+    decode_job* jobs;
+    u32 job_count;
+    atomic_uint next_job;
+    atomic_uint consumed;
+    atomic_uint ready[DECODE_QUEUE_CAPACITY];
+} decode_pool;
+
+// one worker per core, leaving one core to the consumer
+u32 decode_pool_default_thread_count(void);
+
+// jobs must stay alive until decode_pool_join, with no threads every job is decoded inside decode_pool_pop
+void decode_pool_start(decode_pool* pool, decode_job* jobs, u32 job_count, u32 thread_count);
+
+// blocks until the next job in submission order has been decoded, NULL once every job was popped
+decode_job* decode_pool_pop(decode_pool* pool);
+
+void decode_pool_join(decode_pool* pool);
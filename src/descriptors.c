@@ -0,0 +1,300 @@
+#include "descriptors.h"
+
+// descriptors per set of each type, multiplied by DESCRIPTOR_POOL_SETS
+static const VkDescriptorPoolSize descriptor_pool_ratios[] = {
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 4 },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2 },
+    { VK_DESCRIPTOR_TYPE_SAMPLER, 1 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 }
+};
+
+#define DESCRIPTOR_POOL_RATIO_COUNT (sizeof(descriptor_pool_ratios) / sizeof(descriptor_pool_ratios[0]))
+
+static void pool_list_push(descriptor_pool_list* list, VkDescriptorPool pool)
+{
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity > 0 ? list->capacity * 2 : 4;
+        list->pools = (VkDescriptorPool*)realloc(list->pools, sizeof(VkDescriptorPool) * list->capacity);
+    }
+
+    list->pools[list->count++] = pool;
+}
+
+static void pool_list_destroy(descriptor_allocator* allocator, descriptor_pool_list* list)
+{
+    for (u32 i = 0; i < list->count; ++i) {
+        vkDestroyDescriptorPool(allocator->device, list->pools[i], NULL);
+    }
+
+    free(list->pools);
+    memset(list, 0, sizeof(descriptor_pool_list));
+}
+
+void descriptor_allocator_create(descriptor_allocator* allocator, VkDevice device, u32 frame_count)
+{
+    memset(allocator, 0, sizeof(descriptor_allocator));
+
+    allocator->device = device;
+    allocator->frame_count = frame_count;
+    allocator->frames = (descriptor_pool_list*)calloc(frame_count, sizeof(descriptor_pool_list));
+}
+
+void descriptor_allocator_destroy(descriptor_allocator* allocator)
+{
+    for (u32 i = 0; i < allocator->frame_count; ++i) {
+        pool_list_destroy(allocator, &allocator->frames[i]);
+    }
+
+    pool_list_destroy(allocator, &allocator->persistent);
+    pool_list_destroy(allocator, &allocator->free_pools);
+
+    free(allocator->frames);
+    allocator->frames = NULL;
+    allocator->frame_count = 0;
+}
+
+// reset pools are recycled before a new one is created
+static VkDescriptorPool acquire_pool(descriptor_allocator* allocator)
+{
+    if (allocator->free_pools.count > 0) {
+        return allocator->free_pools.pools[--allocator->free_pools.count];
+    }
+
+    VkDescriptorPoolSize pool_sizes[DESCRIPTOR_POOL_RATIO_COUNT];
+    for (u32 i = 0; i < DESCRIPTOR_POOL_RATIO_COUNT; ++i) {
+        pool_sizes[i].type = descriptor_pool_ratios[i].type;
+        pool_sizes[i].descriptorCount = descriptor_pool_ratios[i].descriptorCount * DESCRIPTOR_POOL_SETS;
+    }
+
+    VkDescriptorPoolCreateInfo create_info;
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    create_info.pNext = NULL;
+    create_info.flags = 0;
+    create_info.maxSets = DESCRIPTOR_POOL_SETS;
+    create_info.poolSizeCount = DESCRIPTOR_POOL_RATIO_COUNT;
+    create_info.pPoolSizes = pool_sizes;
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+
+    if (vkCreateDescriptorPool(allocator->device, &create_info, NULL, &pool) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create descriptor pool\n");
+        return VK_NULL_HANDLE;
+    }
+
+    allocator->pools_created += 1;
+
+    return pool;
+}
+
+VkDescriptorSet descriptor_allocator_allocate(descriptor_allocator* allocator, u32 frame, VkDescriptorSetLayout layout)
+{
+    descriptor_pool_list* list = frame == DESCRIPTOR_PERSISTENT ? &allocator->persistent : &allocator->frames[frame];
+
+    VkDescriptorSetAllocateInfo allocate_info;
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.pNext = NULL;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+
+    // only the last pool of a list has room, the ones before it ran out
+    if (list->count > 0) {
+        allocate_info.descriptorPool = list->pools[list->count - 1];
+
+        VkResult result = vkAllocateDescriptorSets(allocator->device, &allocate_info, &set);
+        if (result == VK_SUCCESS) {
+            return set;
+        }
+
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            fprintf(stderr, "failed to allocate descriptor set\n");
+            return VK_NULL_HANDLE;
+        }
+    }
+
+    VkDescriptorPool pool = acquire_pool(allocator);
+    if (pool == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+    }
+
+    pool_list_push(list, pool);
+    allocate_info.descriptorPool = pool;
+
+    // a set that does not fit an empty pool exceeds the ratio table
+    if (vkAllocateDescriptorSets(allocator->device, &allocate_info, &set) != VK_SUCCESS) {
+        fprintf(stderr, "failed to allocate descriptor set from a new pool\n");
+        return VK_NULL_HANDLE;
+    }
+
+    return set;
+}
+
+void descriptor_allocator_reset(descriptor_allocator* allocator, u32 frame)
+{
+    descriptor_pool_list* list = &allocator->frames[frame];
+
+    for (u32 i = 0; i < list->count; ++i) {
+        vkResetDescriptorPool(allocator->device, list->pools[i], 0);
+        pool_list_push(&allocator->free_pools, list->pools[i]);
+    }
+
+    list->count = 0;
+}
+
+void descriptor_layout_cache_create(descriptor_layout_cache* cache, VkDevice device)
+{
+    memset(cache, 0, sizeof(descriptor_layout_cache));
+
+    cache->device = device;
+}
+
+void descriptor_layout_cache_destroy(descriptor_layout_cache* cache)
+{
+    for (u32 i = 0; i < cache->capacity; ++i) {
+        descriptor_layout_entry* entry = &cache->entries[i];
+
+        if (entry->layout == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        vkDestroyDescriptorSetLayout(cache->device, entry->layout, NULL);
+        free(entry->key);
+    }
+
+    free(cache->entries);
+    memset(cache, 0, sizeof(descriptor_layout_cache));
+}
+
+static u32 hash_key(const u64* key, u32 size)
+{
+    const u8* bytes = (const u8*)key;
+    u32 hash = 2166136261u;
+
+    for (u32 i = 0; i < size * sizeof(u64); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static descriptor_layout_entry* find_entry(descriptor_layout_entry* entries, u32 capacity, u32 hash, const u64* key, u32 key_size)
+{
+    u32 slot = hash & (capacity - 1);
+
+    while (entries[slot].layout != VK_NULL_HANDLE) {
+        descriptor_layout_entry* entry = &entries[slot];
+
+        if (entry->hash == hash && entry->key_size == key_size && memcmp(entry->key, key, key_size * sizeof(u64)) == 0) {
+            return entry;
+        }
+
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return &entries[slot];
+}
+
+// kept at most half full
+static void grow_cache(descriptor_layout_cache* cache)
+{
+    u32 capacity = cache->capacity > 0 ? cache->capacity * 2 : 16;
+    descriptor_layout_entry* entries = (descriptor_layout_entry*)calloc(capacity, sizeof(descriptor_layout_entry));
+
+    for (u32 i = 0; i < cache->capacity; ++i) {
+        descriptor_layout_entry* entry = &cache->entries[i];
+
+        if (entry->layout != VK_NULL_HANDLE) {
+            *find_entry(entries, capacity, entry->hash, entry->key, entry->key_size) = *entry;
+        }
+    }
+
+    free(cache->entries);
+    cache->entries = entries;
+    cache->capacity = capacity;
+}
+
+VkDescriptorSetLayout descriptor_layout_cache_get(descriptor_layout_cache* cache, const VkDescriptorSetLayoutBinding* bindings, u32 binding_count, VkDescriptorSetLayoutCreateFlags flags, const VkDescriptorBindingFlags* binding_flags)
+{
+    // bindings are keyed in binding order, so the order they are listed in does not matter
+    u32* order = (u32*)malloc(sizeof(u32) * (binding_count > 0 ? binding_count : 1));
+    u32 key_size = 1;
+
+    for (u32 i = 0; i < binding_count; ++i) {
+        u32 j = i;
+        while (j > 0 && bindings[order[j - 1]].binding > bindings[i].binding) {
+            order[j] = order[j - 1];
+            j -= 1;
+        }
+        order[j] = i;
+
+        key_size += 5 + (bindings[i].pImmutableSamplers != NULL ? bindings[i].descriptorCount : 0);
+    }
+
+    u64* key = (u64*)malloc(sizeof(u64) * key_size);
+    u32 word = 0;
+
+    key[word++] = flags;
+
+    for (u32 i = 0; i < binding_count; ++i) {
+        const VkDescriptorSetLayoutBinding* binding = &bindings[order[i]];
+
+        key[word++] = binding->binding;
+        key[word++] = binding->descriptorType;
+        key[word++] = binding->descriptorCount;
+        key[word++] = binding->stageFlags;
+        key[word++] = binding_flags != NULL ? binding_flags[order[i]] : 0;
+
+        for (u32 s = 0; binding->pImmutableSamplers != NULL && s < binding->descriptorCount; ++s) {
+            key[word++] = (u64)(uintptr_t)binding->pImmutableSamplers[s];
+        }
+    }
+
+    free(order);
+
+    u32 hash = hash_key(key, key_size);
+
+    if ((cache->count + 1) * 2 > cache->capacity) {
+        grow_cache(cache);
+    }
+
+    descriptor_layout_entry* entry = find_entry(cache->entries, cache->capacity, hash, key, key_size);
+
+    if (entry->layout != VK_NULL_HANDLE) {
+        free(key);
+        return entry->layout;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info;
+    flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flags_info.pNext = NULL;
+    flags_info.bindingCount = binding_count;
+    flags_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo create_info;
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.pNext = binding_flags != NULL ? &flags_info : NULL;
+    create_info.flags = flags;
+    create_info.bindingCount = binding_count;
+    create_info.pBindings = bindings;
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+
+    if (vkCreateDescriptorSetLayout(cache->device, &create_info, NULL, &layout) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create descriptor set layout\n");
+        free(key);
+        return VK_NULL_HANDLE;
+    }
+
+    entry->hash = hash;
+    entry->key = key;
+    entry->key_size = key_size;
+    entry->layout = layout;
+    cache->count += 1;
+
+    return layout;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "defines.h"
+
+#include <volk.h>
+
+// sets every pool is sized for, descriptors per set of each type come from a fixed ratio table
+#define DESCRIPTOR_POOL_SETS 64
+
+// frame index for sets that live until the allocator is destroyed
+#define DESCRIPTOR_PERSISTENT UINT32_MAX
+
+typedef struct descriptor_pool_list {
+    VkDescriptorPool* pools;
+    u32 count;
+    u32 capacity;
+} descriptor_pool_list;
+
+// one list of pools per frame in flight, reset in bulk once the frame is done. full pools stay in their
+// list until then and allocation moves on to a fresh or recycled pool
+typedef struct descriptor_allocator {
+    VkDevice device;
+    descriptor_pool_list* frames;
+    u32 frame_count;
+    descriptor_pool_list persistent;
+    descriptor_pool_list free_pools;
+    u32 pools_created;
+} descriptor_allocator;
+
+typedef struct descriptor_layout_entry {
+    u32 hash;
+    u64* key;
+    u32 key_size;
+    VkDescriptorSetLayout layout;
+} descriptor_layout_entry;
+
+// open addressing table of every layout created through it, keyed by the create flags and the sorted bindings
+typedef struct descriptor_layout_cache {
+    VkDevice device;
+    descriptor_layout_entry* entries;
+    u32 count;
+    u32 capacity;
+} descriptor_layout_cache;
+
+void descriptor_allocator_create(descriptor_allocator* allocator, VkDevice device, u32 frame_count);
+void descriptor_allocator_destroy(descriptor_allocator* allocator);
+
+// frame is a frame in flight index or DESCRIPTOR_PERSISTENT, returns VK_NULL_HANDLE on failure
+VkDescriptorSet descriptor_allocator_allocate(descriptor_allocator* allocator, u32 frame, VkDescriptorSetLayout layout);
+
+// frees every set allocated for the frame, the gpu must be done with them
+void descriptor_allocator_reset(descriptor_allocator* allocator, u32 frame);
+
+void descriptor_layout_cache_create(descriptor_layout_cache* cache, VkDevice device);
+void descriptor_layout_cache_destroy(descriptor_layout_cache* cache);
+
+// binding_flags may be NULL, otherwise it holds one entry per binding in the order given. the cache owns the layout
+VkDescriptorSetLayout descriptor_layout_cache_get(descriptor_layout_cache* cache, const VkDescriptorSetLayoutBinding* bindings, u32 binding_count, VkDescriptorSetLayoutCreateFlags flags, const VkDescriptorBindingFlags* binding_flags);
@@ -0,0 +1,104 @@
+#include "file_map.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool file_map_open(file_mapping* mapping, const char* path)
+{
+    mapping->data = NULL;
+    mapping->size = 0;
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+
+    if (!handle) {
+        return false;
+    }
+
+    void* data = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(handle);
+
+    if (!data) {
+        return false;
+    }
+
+    mapping->size = (u64)file_size.QuadPart;
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+        close(file);
+        return false;
+    }
+
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    mapping->size = (u64)info.st_size;
+#endif
+
+    mapping->data = data;
+    return true;
+}
+
+void file_map_close(file_mapping* mapping)
+{
+    if (!mapping->data) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(mapping->data);
+#else
+    munmap(mapping->data, (size_t)mapping->size);
+#endif
+
+    mapping->data = NULL;
+    mapping->size = 0;
+}
+
+bool file_map_stat(const char* path, i64* mtime, u64* size)
+{
+#if defined(_WIN32)
+    struct __stat64 info;
+    if (_stat64(path, &info) != 0) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return false;
+    }
+#endif
+
+    *mtime = (i64)info.st_mtime;
+    *size = (u64)info.st_size;
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "defines.h"
+
+// a read-only view of a whole file
+typedef struct file_mapping {
+    void* data;
+    u64 size;
+} file_mapping;
+
+bool file_map_open(file_mapping* mapping, const char* path);
+void file_map_close(file_mapping* mapping);
+
+// modification time in seconds since the epoch and size in bytes
+bool file_map_stat(const char* path, i64* mtime, u64* size);
@@ -0,0 +1,181 @@
+#include "frame_stats.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+static const char* frame_stage_names[FRAME_STAGE_COUNT] = {
+    "frame wait",
+    "acquire",
+    "record",
+    "submit",
+    "present",
+    "frame",
+    "gpu render pass",
+    "gpu draw",
+    "input latency",
+};
+
+u64 frame_clock_now(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    // split so the scale to nanoseconds cannot overflow
+    u64 seconds = (u64)counter.QuadPart / (u64)frequency.QuadPart;
+    u64 remainder = (u64)counter.QuadPart % (u64)frequency.QuadPart;
+
+    return seconds * 1000000000ull + remainder * 1000000000ull / (u64)frequency.QuadPart;
+#else
+    struct timespec ts;
+
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#elif defined(TIME_MONOTONIC)
+    timespec_get(&ts, TIME_MONOTONIC);
+#else
+    // no monotonic source in the c runtime, frame_clock_tick clamps backwards steps
+    timespec_get(&ts, TIME_UTC);
+#endif
+
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+#endif
+}
+
+f32 frame_clock_tick(u64* last)
+{
+    u64 now = frame_clock_now();
+    u64 elapsed = now > *last ? now - *last : 0;
+    *last = now;
+
+    return (f32)((f64)elapsed * 1e-9);
+}
+
+static u32 highest_bit(u64 value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - (u32)__builtin_clzll(value);
+#else
+    u32 bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+static u32 bucket_index(u64 value)
+{
+    if (value < FRAME_HISTOGRAM_SUB_BUCKET_COUNT) {
+        return (u32)value;
+    }
+
+    u32 exponent = highest_bit(value);
+    u32 shift = exponent - FRAME_HISTOGRAM_SUB_BUCKET_BITS;
+    u32 sub_bucket = (u32)(value >> shift) & (FRAME_HISTOGRAM_SUB_BUCKET_COUNT - 1);
+
+    return (shift + 1) * FRAME_HISTOGRAM_SUB_BUCKET_COUNT + sub_bucket;
+}
+
+static u64 bucket_value(u32 index)
+{
+    if (index < FRAME_HISTOGRAM_SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    u32 shift = index / FRAME_HISTOGRAM_SUB_BUCKET_COUNT - 1;
+    u64 sub_bucket = index % FRAME_HISTOGRAM_SUB_BUCKET_COUNT;
+    u64 lower = (FRAME_HISTOGRAM_SUB_BUCKET_COUNT + sub_bucket) << shift;
+
+    return lower + ((1ull << shift) >> 1);
+}
+
+void frame_stats_reset(frame_stats* stats)
+{
+    memset(stats, 0, sizeof(frame_stats));
+
+    for (u32 i = 0; i < FRAME_STAGE_COUNT; ++i) {
+        stats->stages[i].min = UINT64_MAX;
+    }
+}
+
+void frame_stats_record(frame_stats* stats, frame_stage stage, u64 duration_ns)
+{
+    frame_histogram* histogram = &stats->stages[stage];
+
+    histogram->count += 1;
+    histogram->sum += duration_ns;
+    histogram->min = duration_ns < histogram->min ? duration_ns : histogram->min;
+    histogram->max = duration_ns > histogram->max ? duration_ns : histogram->max;
+    histogram->buckets[bucket_index(duration_ns)] += 1;
+}
+
+void frame_stats_lap(frame_stats* stats, frame_stage stage, u64* start)
+{
+    u64 now = frame_clock_now();
+    frame_stats_record(stats, stage, now > *start ? now - *start : 0);
+    *start = now;
+}
+
+u64 frame_histogram_percentile(const frame_histogram* histogram, f64 percentile)
+{
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    u64 rank = (u64)ceil(percentile * 0.01 * (f64)histogram->count);
+    rank = rank < 1 ? 1 : rank;
+
+    u64 seen = 0;
+    for (u32 i = 0; i < FRAME_HISTOGRAM_BUCKET_COUNT; ++i) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            u64 value = bucket_value(i);
+            value = value < histogram->min ? histogram->min : value;
+            value = value > histogram->max ? histogram->max : value;
+            return value;
+        }
+    }
+
+    return histogram->max;
+}
+
+void frame_stats_print(const frame_stats* stats, FILE* stream)
+{
+    fprintf(stream, "%-16s %8s %9s %9s %9s %9s %9s (ms)\n", "stage", "count", "mean", "p50", "p90", "p99", "max");
+
+    for (u32 i = 0; i < FRAME_STAGE_COUNT; ++i) {
+        const frame_histogram* histogram = &stats->stages[i];
+
+        if (histogram->count == 0) {
+            continue;
+        }
+
+        fprintf(stream, "%-16s %8" PRIu64 " %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+            frame_stage_names[i],
+            histogram->count,
+            (f64)histogram->sum / (f64)histogram->count * 1e-6,
+            (f64)frame_histogram_percentile(histogram, 50.0) * 1e-6,
+            (f64)frame_histogram_percentile(histogram, 90.0) * 1e-6,
+            (f64)frame_histogram_percentile(histogram, 99.0) * 1e-6,
+            (f64)histogram->max * 1e-6);
+    }
+
+    const frame_histogram* frame = &stats->stages[FRAME_STAGE_FRAME];
+    const frame_histogram* gpu = &stats->stages[FRAME_STAGE_GPU_RENDER_PASS];
+
+    if (frame->count > 0 && gpu->count > 0) {
+        f64 frame_mean = (f64)frame->sum / (f64)frame->count;
+        f64 gpu_mean = (f64)gpu->sum / (f64)gpu->count;
+        f64 wait_mean = stats->stages[FRAME_STAGE_FRAME_WAIT].count > 0 ? (f64)stats->stages[FRAME_STAGE_FRAME_WAIT].sum / (f64)stats->stages[FRAME_STAGE_FRAME_WAIT].count : 0.0;
+
+        // the cpu only blocks on the timeline when the gpu is behind
+        fprintf(stream, "gpu busy %.1f%% of frame, cpu waiting %.1f%% -> %s bound\n",
+            gpu_mean / frame_mean * 100.0,
+            wait_mean / frame_mean * 100.0,
+            wait_mean > frame_mean * 0.1 ? "gpu" : "cpu");
+    }
+}
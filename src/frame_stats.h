@@ -0,0 +1,49 @@
+#pragma once
+
+#include "defines.h"
+
+// log-linear histogram: every power of two is split into 2^FRAME_HISTOGRAM_SUB_BUCKET_BITS sub buckets
+#define FRAME_HISTOGRAM_SUB_BUCKET_BITS 5
+#define FRAME_HISTOGRAM_SUB_BUCKET_COUNT (1u << FRAME_HISTOGRAM_SUB_BUCKET_BITS)
+#define FRAME_HISTOGRAM_BUCKET_COUNT ((64 - FRAME_HISTOGRAM_SUB_BUCKET_BITS + 1) * FRAME_HISTOGRAM_SUB_BUCKET_COUNT)
+
+typedef enum frame_stage {
+    FRAME_STAGE_FRAME_WAIT,
+    FRAME_STAGE_ACQUIRE,
+    FRAME_STAGE_RECORD,
+    FRAME_STAGE_SUBMIT,
+    FRAME_STAGE_PRESENT,
+    FRAME_STAGE_FRAME,
+    FRAME_STAGE_GPU_RENDER_PASS,
+    FRAME_STAGE_GPU_DRAW,
+    FRAME_STAGE_INPUT_LATENCY,
+    FRAME_STAGE_COUNT
+} frame_stage;
+
+typedef struct frame_histogram {
+    u64 count;
+    u64 sum;
+    u64 min;
+    u64 max;
+    u32 buckets[FRAME_HISTOGRAM_BUCKET_COUNT];
+} frame_histogram;
+
+typedef struct frame_stats {
+    frame_histogram stages[FRAME_STAGE_COUNT];
+} frame_stats;
+
+// monotonic time in nanoseconds
+u64 frame_clock_now(void);
+
+// seconds elapsed since *last, advancing *last to now
+f32 frame_clock_tick(u64* last);
+
+void frame_stats_reset(frame_stats* stats);
+void frame_stats_record(frame_stats* stats, frame_stage stage, u64 duration_ns);
+
+// records the time since *start for stage and restarts *start at the current time
+void frame_stats_lap(frame_stats* stats, frame_stage stage, u64* start);
+
+u64 frame_histogram_percentile(const frame_histogram* histogram, f64 percentile);
+
+void frame_stats_print(const frame_stats* stats, FILE* stream);
@@ -0,0 +1,118 @@
+#include "ktx2.h"
+#include "mipmap.h"
+
+#define KTX2_HEADER_SIZE 80
+#define KTX2_LEVEL_INDEX_ENTRY_SIZE 24
+
+static const u8 ktx2_identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+static u32 read_u32(const u8* data)
+{
+    return (u32)data[0] | ((u32)data[1] << 8) | ((u32)data[2] << 16) | ((u32)data[3] << 24);
+}
+
+static u64 read_u64(const u8* data)
+{
+    return (u64)read_u32(data) | ((u64)read_u32(data + 4) << 32);
+}
+
+u32 ktx2_block_size(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+static bool parse(ktx2_texture* texture, u32 max_dimension)
+{
+    const u8* data = (const u8*)texture->mapping.data;
+    u64 size = texture->mapping.size;
+
+    if (size < KTX2_HEADER_SIZE || memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) != 0) {
+        return false;
+    }
+
+    texture->format = (VkFormat)read_u32(data + 12);
+    texture->width = read_u32(data + 20);
+    texture->height = read_u32(data + 24);
+
+    u32 depth = read_u32(data + 28);
+    u32 layer_count = read_u32(data + 32);
+    u32 face_count = read_u32(data + 36);
+    u32 level_count = read_u32(data + 40);
+    u32 supercompression = read_u32(data + 44);
+
+    u32 block_size = ktx2_block_size(texture->format);
+
+    // only plain 2d textures that the gpu can sample as stored
+    if (block_size == 0 || texture->width == 0 || texture->height == 0 || texture->width > max_dimension || texture->height > max_dimension || depth > 0 || layer_count > 1 || face_count != 1 || supercompression != 0) {
+        return false;
+    }
+
+    // a level count of 0 asks the loader to generate mips, which block compressed data cannot do
+    level_count = level_count == 0 ? 1 : level_count;
+
+    if (level_count > KTX2_MAX_LEVELS || level_count > mipmap_level_count(texture->width, texture->height) || KTX2_HEADER_SIZE + (u64)level_count * KTX2_LEVEL_INDEX_ENTRY_SIZE > size) {
+        return false;
+    }
+
+    texture->level_count = level_count;
+
+    for (u32 i = 0; i < level_count; ++i) {
+        const u8* entry = data + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        u64 offset = read_u64(entry);
+        u64 length = read_u64(entry + 8);
+
+        u32 width = texture->width >> i > 0 ? texture->width >> i : 1;
+        u32 height = texture->height >> i > 0 ? texture->height >> i : 1;
+        u64 expected = (u64)((width + 3) / 4) * ((height + 3) / 4) * block_size;
+
+        if (length != expected || offset > size || length > size - offset) {
+            return false;
+        }
+
+        texture->levels[i].data = data + offset;
+        texture->levels[i].size = length;
+        texture->levels[i].width = width;
+        texture->levels[i].height = height;
+    }
+
+    return true;
+}
+
+bool ktx2_open(ktx2_texture* texture, const char* path, u32 max_dimension)
+{
+    memset(texture, 0, sizeof(ktx2_texture));
+
+    if (!file_map_open(&texture->mapping, path)) {
+        return false;
+    }
+
+    if (!parse(texture, max_dimension)) {
+        fprintf(stderr, "failed to parse ktx2 file %s\n", path);
+        ktx2_close(texture);
+        return false;
+    }
+
+    return true;
+}
+
+void ktx2_close(ktx2_texture* texture)
+{
+    file_map_close(&texture->mapping);
+
+    memset(texture, 0, sizeof(ktx2_texture));
+}
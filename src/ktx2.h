@@ -0,0 +1,33 @@
+#pragma once
+
+#include "defines.h"
+#include "file_map.h"
+
+#include <volk.h>
+
+#define KTX2_MAX_LEVELS 16
+
+typedef struct ktx2_level {
+    const u8* data;
+    u64 size;
+    u32 width;
+    u32 height;
+} ktx2_level;
+
+// a read-only mapping of a ktx2 file, level data points straight into the mapping
+typedef struct ktx2_texture {
+    file_mapping mapping;
+    VkFormat format;
+    u32 width;
+    u32 height;
+    u32 level_count;
+    ktx2_level levels[KTX2_MAX_LEVELS];
+} ktx2_texture;
+
+// bytes per 4x4 block for the supported block compressed formats, 0 for anything else
+u32 ktx2_block_size(VkFormat format);
+
+// maps path and validates it as an uncompressed-container 2d texture in one of the bc formats, no larger than
+// max_dimension on either side and with no more levels than its size allows
+bool ktx2_open(ktx2_texture* texture, const char* path, u32 max_dimension);
+void ktx2_close(ktx2_texture* texture);
@@ -1,7 +1,17 @@
 #include "defines.h"
-
-// TODO: platform specific code (delta time)
-#include <windows.h>
+#include "frame_stats.h"
+#include "allocator.h"
+#include "mipmap.h"
+#include "ktx2.h"
+#include "decode_pool.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "task_pool.h"
+#include "scene.h"
+#include "cull.h"
+#include "transform.h"
+#include "descriptors.h"
+#include "shader_watch.h"
 
 #include <volk.h>
 #include <GLFW/glfw3.h>
@@ -11,7 +21,68 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#define MAX_FRAMES_IN_FLIGHT 2
+#define MAX_FRAMES_IN_FLIGHT 4
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+
+#define HEADLESS_WIDTH 1280
+#define HEADLESS_HEIGHT 720
+#define HEADLESS_FORMAT VK_FORMAT_B8G8R8A8_SRGB
+
+#define BENCHMARK_DEFAULT_FRAMES 1000
+#define BENCHMARK_WARMUP_FRAMES 16
+
+#define STAGING_RING_SIZE (16ull * 1024 * 1024)
+#define STAGING_MAX_SUBMISSIONS 64
+#define STAGING_DEFAULT_ALIGNMENT 16
+
+#define UPLOAD_MAX_BATCHES 16
+
+#define TEXTURE_KTX2_VARIANTS 3
+
+// bindless texture table, clamped to the device's update after bind limits
+#define TEXTURE_TABLE_SIZE 4096
+#define TEXTURE_TABLE_SAMPLERS 8
+
+#define PIPELINE_CACHE_PATH "pipeline_cache.bin"
+
+#define MAX_RETIRED_SWAPCHAINS 8
+
+// pipelines replaced by a shader reload, released once the frames using them have finished
+#define MAX_RETIRED_PIPELINES 8
+
+// set by the build, the fallbacks assume the working directory is the build directory
+#ifndef SHADER_SOURCE_DIR
+#define SHADER_SOURCE_DIR "../shaders"
+#endif
+
+#ifndef SHADER_COMPILER
+#define SHADER_COMPILER "glslangValidator"
+#endif
+
+// frames that carried input and wait for their present to reach the display
+#define MAX_LATENCY_SAMPLES 16
+
+// longest a single present wait holds the swapchain, the render loop takes it in between
+#define LATENCY_WAIT_SLICE_NS 200000
+
+#define UNIFORM_ARENA_FRAME_SIZE (64 * 1024)
+
+#define INSTANCE_SWEEP_MAX 65536
+#define INSTANCE_MATERIAL_COUNT 4
+
+#define CULL_BENCHMARK_OBJECTS (1u << 20)
+#define CULL_BENCHMARK_ITERATIONS 64
+
+#define CULL_WORKGROUP_SIZE 64
+
+#define TIMESTAMP_RENDER_PASS_BEGIN 0
+#define TIMESTAMP_RENDER_PASS_END 1
+#define TIMESTAMP_FIRST_DRAW 2
+#define TIMESTAMP_MAX_DRAWS 64
+#define TIMESTAMP_QUERY_COUNT (TIMESTAMP_FIRST_DRAW + 2 * TIMESTAMP_MAX_DRAWS)
+
+// every recording slice gets a timestamp pair around its draws
+#define MAX_RECORD_THREADS TIMESTAMP_MAX_DRAWS
 
 typedef struct queue_family {
     VkQueue queue;
@@ -23,6 +94,13 @@ typedef struct device_state {
     VkDevice device;
     queue_family graphics_queue;
     queue_family present_queue;
+    queue_family transfer_queue;
+    bool texture_compression_bc;
+    bool draw_indirect_count;
+    bool present_wait;
+    bool dynamic_rendering;
+    bool descriptor_indexing;
+    u32 max_bindless_textures;
 } device_state;
 
 typedef struct surface_state {
@@ -46,56 +124,297 @@ typedef struct pipeline_state {
     VkPipeline pipeline;
 } pipeline_state;
 
+typedef struct retired_swapchain {
+    VkSwapchainKHR swapchain;
+    u32 image_count;
+    VkImage* images;
+    VkImageView* image_views;
+    VkFramebuffer* framebuffers;
+    VkRenderPass render_pass;
+    pipeline_state pipeline;
+    u64 last_value;
+} retired_swapchain;
+
+typedef struct retired_pipeline {
+    VkPipeline pipeline;
+    u64 last_value;
+} retired_pipeline;
+
+// one reload job at a time, the fields after done belong to the worker until it sets it
+typedef struct shader_reload {
+    shader_watch watch;
+    thrd_t thread;
+    bool running;
+    atomic_bool done;
+    char sources[SHADER_WATCH_MAX_CHANGES][SHADER_WATCH_NAME_SIZE];
+    u32 source_count;
+    bool graphics;
+    bool compute;
+    VkFormat format;
+    VkRenderPass render_pass;
+    VkPipeline graphics_pipeline;
+    VkPipeline cull_pipeline;
+} shader_reload;
+
+typedef struct timestamp_state {
+    VkQueryPool* query_pools;
+    u32* query_counts;
+    f64 period;
+    u64 valid_mask;
+    bool supported;
+} timestamp_state;
+
 typedef struct buffer {
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    memory_allocation allocation;
 } buffer;
 
-typedef struct vertex {
-    vec2 position;
-    vec3 color;
-    vec2 tex_coord;
-} vertex;
+typedef struct staging_submission {
+    u64 value;
+    VkDeviceSize end;
+    buffer* temporaries;
+    u32 temporary_count;
+} staging_submission;
+
+typedef struct staging_ring {
+    buffer buffer;
+    u8* mapped;
+    VkDeviceSize size;
+    VkDeviceSize head;
+    VkDeviceSize tail;
+    staging_submission submissions[STAGING_MAX_SUBMISSIONS];
+    u32 first_submission;
+    u32 submission_count;
+    buffer* temporaries;
+    u32 temporary_count;
+} staging_ring;
+
+typedef struct staging_region {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    void* mapped;
+} staging_region;
+
+typedef struct upload_batch {
+    u64 value;
+    VkSemaphore semaphore;
+    VkCommandBuffer transfer_commands;
+    VkCommandBuffer graphics_commands;
+} upload_batch;
+
+typedef struct upload_context {
+    VkCommandPool transfer_pool;
+    VkCommandPool graphics_pool;
+    VkCommandBuffer transfer_commands;
+    VkCommandBuffer graphics_commands;
+    bool recording;
+    bool dedicated_transfer;
+    upload_batch batches[UPLOAD_MAX_BATCHES];
+    u32 first_batch;
+    u32 batch_count;
+} upload_context;
 
 typedef struct uniform_buffer_object {
-    mat4 model;
     mat4 view;
     mat4 projection;
 } uniform_buffer_object;
 
+// std430 layout of InstanceData in shader.vert, plain floats keep cglm's wider alignment out of the stride
+typedef struct instance_data {
+    f32 model[16];
+    u32 material;
+    u32 texture;
+    u32 sampler;
+    u32 padding;
+} instance_data;
+
+// set 1 in bindless mode: every texture and sampler registered once, indexed per instance
+typedef struct texture_table {
+    VkDescriptorSetLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    u32 capacity;
+    u32 texture_count;
+    u32 sampler_count;
+} texture_table;
+
+// std430 layout of ObjectData in cull.comp, the local bounding sphere and draw arguments of one object
+typedef struct gpu_object {
+    f32 sphere[4];
+    u32 index_count;
+    u32 first_index;
+    i32 vertex_offset;
+    u32 padding;
+} gpu_object;
+
+// push constants of cull.comp
+typedef struct cull_constants {
+    f32 planes[6][4];
+    u32 object_count;
+} cull_constants;
+
+typedef struct latency_sample {
+    VkSwapchainKHR swapchain;
+    u64 present_id;
+    u64 input_time;
+} latency_sample;
+
+// waits for presents on its own thread so a sample ends when the image is displayed, not when the next frame
+// looks. the swapchain needs external synchronization, lock guards it and render_waiting gives the render loop priority
+typedef struct latency_waiter {
+    thrd_t thread;
+    bool running;
+    bool stop;
+    mtx_t lock;
+    cnd_t pending_added;
+    atomic_uint render_waiting;
+    latency_sample pending[MAX_LATENCY_SAMPLES];
+    u32 pending_count;
+    u64 results[MAX_LATENCY_SAMPLES];
+    u32 result_count;
+    u32 dropped;
+} latency_waiter;
+
 typedef struct image {
     VkImage image;
-    VkDeviceMemory memory;
+    memory_allocation allocation;
 } image;
 
+// one persistently mapped uniform buffer split into a region per frame in flight, blocks are bump allocated
+// from the current frame's region and bound through dynamic offsets
+typedef struct uniform_arena {
+    buffer buffer;
+    u8* mapped;
+    VkDeviceSize alignment;
+    VkDeviceSize frame_size;
+    VkDeviceSize frame_offset;
+    VkDeviceSize head;
+} uniform_arena;
+
+typedef struct texture_asset {
+    const char* image_path;
+    // block compressed variants in order of preference
+    const char* ktx2_paths[TEXTURE_KTX2_VARIANTS];
+} texture_asset;
+
+// the decoded form of a texture_asset, filled on a decode thread
+typedef struct texture_source {
+    const texture_asset* asset;
+    bool compressed;
+    ktx2_texture ktx2;
+    stbi_uc* pixels;
+    u8* mip_chain;
+    u32 width;
+    u32 height;
+    u32 mip_levels;
+} texture_source;
+
+// the vertex and index streams of a mesh asset, ready to be copied into staging
+typedef struct mesh_source {
+    const char* path;
+    mesh_cache cache;
+} mesh_source;
+
+// one per recording thread, pools and secondaries are indexed by frame in flight
+typedef struct record_slice {
+    VkCommandPool* command_pools;
+    VkCommandBuffer* command_buffers;
+} record_slice;
+
 typedef struct application_state {
     GLFWwindow* window;
     VkInstance instance;
     VkDebugUtilsMessengerEXT debug_messenger;
     surface_state surface;
     device_state device;
+    memory_allocator allocator;
     swapchain_state swapchain;
     VkRenderPass render_pass;
     VkFramebuffer* framebuffers;
     VkDescriptorSetLayout descriptor_set_layout;
+    VkPipelineCache pipeline_cache;
     pipeline_state graphics_pipeline;
-    VkCommandPool command_pool;
+    VkCommandPool* command_pools;
     VkCommandBuffer* command_buffers;
+    record_slice* record_slices;
+    u32 record_thread_count;
+    u32 record_slice_count;
+    u32 record_image_index;
+    task_pool recorder;
+    u32 draw_count;
+    staging_ring staging;
+    upload_context uploads;
+    decode_pool decoder;
+    decode_job* decode_jobs;
+    texture_source* texture_sources;
+    mesh_source* mesh_sources;
     VkSemaphore* image_available_semaphores;
     VkSemaphore* render_finished_semaphores;
-    VkFence* in_flight_fences;
+    VkSemaphore timeline;
+    u64 timeline_value;
+    u64* frame_values;
+    timestamp_state timestamps;
     unsigned char current_frame;
+    u32 frames_in_flight;
+    VkPresentModeKHR requested_present_mode;
+    u32 requested_image_count;
+    u64 input_time;
+    latency_waiter latency;
+    u64 frame_number;
+    retired_swapchain retired_swapchains[MAX_RETIRED_SWAPCHAINS];
+    u32 retired_swapchain_count;
     bool framebuffer_resized;
     buffer vertex_buffer;
     buffer index_buffer;
-    buffer* uniform_buffers;
-    void** uniform_buffers_mapped;
-    VkDescriptorPool descriptor_pool;
-    VkDescriptorSet* descriptor_sets;
+    u32 index_count;
+    VkIndexType index_type;
+    uniform_arena uniforms;
+    u32 camera_offset;
+    buffer instance_buffer;
+    VkDeviceSize instance_frame_size;
+    u32 instance_count;
+    u32 instance_capacity;
+    transform_system transforms;
+    u32 instance_layout_count;
+    f32 instance_scale;
+    scene_objects objects;
+    instance_data* object_instances;
+    u32* visible_objects;
+    u32 visible_count;
+    f32 view_projection[16];
+    f32 mesh_center[3];
+    f32 mesh_extent[3];
+    bool cull_benchmark;
+    bool gpu_culling;
+    VkDescriptorSetLayout cull_set_layout;
+    pipeline_state cull_pipeline;
+    buffer object_buffer;
+    buffer draw_command_buffer;
+    VkDeviceSize draw_command_frame_size;
+    buffer draw_count_buffer;
+    VkDeviceSize draw_count_frame_size;
+    bool instance_sweep;
+    f32 elapsed_time;
+    descriptor_layout_cache layouts;
+    descriptor_allocator descriptors;
+    VkDescriptorSet descriptor_set;
     image texture_image;
+    u32 texture_mip_levels;
     VkImageView texture_image_view;
     VkSampler texture_sampler;
-    LARGE_INTEGER last_time;
+    bool bindless;
+    texture_table textures;
+    u32 texture_index;
+    u32 sampler_index;
+    bool hot_reload;
+    shader_reload reload;
+    retired_pipeline retired_pipelines[MAX_RETIRED_PIPELINES];
+    u32 retired_pipeline_count;
+    u64 last_time;
+    frame_stats stats;
+    bool headless;
+    u32 benchmark_frames;
+    image* offscreen_images;
 } application_state;
 
 static void glfw_error_callback(int code, const char* description)
@@ -112,6 +431,46 @@ static void glfw_framebuffer_resize_callback(GLFWwindow* window, int width, int
     state->framebuffer_resized = true;
 }
 
+// glfw has no event timestamps, the clock starts in the poll that delivers the first unconsumed event
+static void mark_input(application_state* state)
+{
+    if (state->input_time == 0) {
+        state->input_time = frame_clock_now();
+    }
+}
+
+static void glfw_cursor_position_callback(GLFWwindow* window, double x, double y)
+{
+    (void)x;
+    (void)y;
+
+    mark_input((application_state*)glfwGetWindowUserPointer(window));
+}
+
+static void glfw_mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    (void)button;
+    (void)action;
+    (void)mods;
+
+    mark_input((application_state*)glfwGetWindowUserPointer(window));
+}
+
+static void glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    (void)scancode;
+    (void)mods;
+
+    application_state* state = (application_state*)glfwGetWindowUserPointer(window);
+    mark_input(state);
+
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
+        frame_stats_print(&state->stats, stdout);
+        frame_stats_reset(&state->stats);
+        memory_allocator_print_stats(&state->allocator, stdout);
+    }
+}
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_messenger_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity, VkDebugUtilsMessageTypeFlagsEXT message_type, const VkDebugUtilsMessengerCallbackDataEXT* callback_data, void* user_data)
 {
     (void)message_severity;
@@ -123,10 +482,20 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_messenger_callback(VkDebugUtilsMessa
     return VK_FALSE;
 }
 
-static LARGE_INTEGER clock_frequency;
-
 void recreate_swapchain(application_state* state);
-void update_uniform_buffer(application_state* state, u32 current_image, f32 dt);
+void collect_present_latency(application_state* state);
+void lock_swapchain(application_state* state);
+void unlock_swapchain(application_state* state);
+void release_retired_swapchains(application_state* state, bool all);
+VkPipeline build_cull_pipeline(application_state* state);
+void update_shader_reload(application_state* state);
+void finish_shader_reload(application_state* state);
+u64 flush_uploads(application_state* state);
+void retire_uploads(application_state* state, bool wait);
+void update_uniform_buffer(application_state* state);
+void begin_uniform_frame(application_state* state, u32 frame);
+void update_instances(application_state* state, u32 current_image, f32 dt);
+void create_image(application_state* state, u32 width, u32 height, u32 mip_levels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* img, memory_allocation* img_allocation);
 
 void initialize_window(application_state* state)
 {
@@ -136,6 +505,9 @@ void initialize_window(application_state* state)
     state->window = glfwCreateWindow(1280, 720, "vulkan tutorial", NULL, NULL);
     glfwSetWindowUserPointer(state->window, state);
     glfwSetFramebufferSizeCallback(state->window, glfw_framebuffer_resize_callback);
+    glfwSetKeyCallback(state->window, glfw_key_callback);
+    glfwSetCursorPosCallback(state->window, glfw_cursor_position_callback);
+    glfwSetMouseButtonCallback(state->window, glfw_mouse_button_callback);
 }
 
 void create_instance(application_state* state)
@@ -149,13 +521,21 @@ void create_instance(application_state* state)
     info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
     info.apiVersion = VK_API_VERSION_1_3;
 
-    const char* extensions[] = {
-        VK_KHR_SURFACE_EXTENSION_NAME,
-        VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+    const char* extensions[16];
+    unsigned int extension_count = 0;
+
+    if (!state->headless) {
+        unsigned int glfw_extension_count = 0;
+        const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+
+        for (unsigned int i = 0; i < glfw_extension_count && extension_count < sizeof(extensions) / sizeof(extensions[0]) - 1; ++i) {
+            extensions[extension_count++] = glfw_extensions[i];
+        }
+    }
+
 #ifndef NDEBUG
-        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+    extensions[extension_count++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
 #endif
-    };
 
     VkInstanceCreateInfo create_info;
     create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -164,8 +544,8 @@ void create_instance(application_state* state)
     create_info.pApplicationInfo = &info;
     create_info.enabledLayerCount = 0;
     create_info.ppEnabledLayerNames = NULL;
-    create_info.enabledExtensionCount = sizeof(extensions) / sizeof(extensions[0]);
-    create_info.ppEnabledExtensionNames = extensions;
+    create_info.enabledExtensionCount = extension_count;
+    create_info.ppEnabledExtensionNames = extension_count > 0 ? extensions : NULL;
 
 #ifndef NDEBUG
     const char* layers[] = {
@@ -230,10 +610,6 @@ bool physical_device_suitable(VkPhysicalDevice device, application_state* state)
 
     printf("checking physical device: %s\n", properties.deviceName);
 
-    if (properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
-        return false;
-    }
-
     VkPhysicalDeviceFeatures features;
     vkGetPhysicalDeviceFeatures(device, &features);
 
@@ -254,6 +630,10 @@ bool physical_device_suitable(VkPhysicalDevice device, application_state* state)
             graphics_queue_available = true;
         }
 
+        if (state->headless) {
+            continue;
+        }
+
         VkBool32 present_supported = VK_FALSE;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, state->surface.surface, &present_supported);
         if (present_supported == VK_TRUE) {
@@ -263,7 +643,33 @@ bool physical_device_suitable(VkPhysicalDevice device, application_state* state)
 
     free(queue_families);
 
-    if (!graphics_queue_available || !present_queue_available) {
+    if (!graphics_queue_available) {
+        return false;
+    }
+
+    // frame pacing and upload completion both wait on a timeline semaphore
+    VkPhysicalDeviceVulkan12Features features12 = {0};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features2 = {0};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features12;
+
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    if (!features12.timelineSemaphore) {
+        return false;
+    }
+
+    if (state->headless) {
+        return true;
+    }
+
+    if (!present_queue_available) {
         return false;
     }
 
@@ -284,6 +690,17 @@ bool physical_device_suitable(VkPhysicalDevice device, application_state* state)
     return true;
 }
 
+unsigned int physical_device_score(VkPhysicalDeviceType type)
+{
+    switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+        default: return 0;
+    }
+}
+
 void pick_physical_device(application_state* state)
 {
     state->device.physical_device = VK_NULL_HANDLE;
@@ -293,13 +710,20 @@ void pick_physical_device(application_state* state)
     VkPhysicalDevice* devices = (VkPhysicalDevice*)calloc(device_count, sizeof(VkPhysicalDevice));
     vkEnumeratePhysicalDevices(state->instance, &device_count, devices);
 
+    unsigned int best_score = 0;
+
     for (unsigned int i = 0; i < device_count; ++i) {
-        if (physical_device_suitable(devices[i], state)) {
+        if (!physical_device_suitable(devices[i], state)) {
+            continue;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(devices[i], &properties);
+
+        unsigned int score = physical_device_score(properties.deviceType) + 1;
+        if (score > best_score) {
             state->device.physical_device = devices[i];
-            VkPhysicalDeviceProperties properties;
-            vkGetPhysicalDeviceProperties(state->device.physical_device, &properties);
-            printf("physical device: %s\n", properties.deviceName);
-            break;
+            best_score = score;
         }
     }
 
@@ -310,25 +734,34 @@ void pick_physical_device(application_state* state)
         return;
     }
 
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(state->device.physical_device, &properties);
+    printf("physical device: %s\n", properties.deviceName);
+
     unsigned int queue_family_count = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(state->device.physical_device, &queue_family_count, NULL);
     VkQueueFamilyProperties* queue_families = (VkQueueFamilyProperties*)calloc(queue_family_count, sizeof(VkQueueFamilyProperties));
     vkGetPhysicalDeviceQueueFamilyProperties(state->device.physical_device, &queue_family_count, queue_families);
 
-    bool graphics_queue_found = true;
-    bool present_queue_found = true;
+    bool graphics_queue_found = false;
+    bool present_queue_found = false;
 
     for (unsigned int i = 0; i < queue_family_count; ++i) {
-        if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if (!graphics_queue_found && queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             state->device.graphics_queue.index = i;
             graphics_queue_found = true;
         }
 
-        VkBool32 present_supported = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(state->device.physical_device, i, state->surface.surface, &present_supported);
-        if (present_supported == VK_TRUE) {
-            state->device.present_queue.index = i;
-            present_queue_found = true;
+        if (state->headless) {
+            state->device.present_queue.index = state->device.graphics_queue.index;
+            present_queue_found = graphics_queue_found;
+        } else if (!present_queue_found) {
+            VkBool32 present_supported = VK_FALSE;
+            vkGetPhysicalDeviceSurfaceSupportKHR(state->device.physical_device, i, state->surface.surface, &present_supported);
+            if (present_supported == VK_TRUE) {
+                state->device.present_queue.index = i;
+                present_queue_found = true;
+            }
         }
 
         if (graphics_queue_found && present_queue_found) {
@@ -336,52 +769,237 @@ void pick_physical_device(application_state* state)
         }
     }
 
+    // prefer a transfer only family (dma engine), then any non graphics family that can copy
+    state->device.transfer_queue.index = state->device.graphics_queue.index;
+    unsigned int transfer_score = 0;
+
+    for (unsigned int i = 0; i < queue_family_count; ++i) {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || flags & VK_QUEUE_GRAPHICS_BIT) {
+            continue;
+        }
+
+        unsigned int score = flags & VK_QUEUE_COMPUTE_BIT ? 1 : 2;
+        if (score > transfer_score) {
+            state->device.transfer_queue.index = i;
+            transfer_score = score;
+        }
+    }
+
     free(queue_families);
 }
 
+bool device_extension_supported(VkPhysicalDevice device, const char* name)
+{
+    unsigned int extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, NULL);
+    VkExtensionProperties* extensions = (VkExtensionProperties*)calloc(extension_count, sizeof(VkExtensionProperties));
+    vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, extensions);
+
+    bool supported = false;
+    for (unsigned int i = 0; i < extension_count; ++i) {
+        if (strcmp(extensions[i].extensionName, name) == 0) {
+            supported = true;
+            break;
+        }
+    }
+
+    free(extensions);
+
+    return supported;
+}
+
 void create_device(application_state* state)
 {
     float queue_priority[] = {1.0f};
 
-    unsigned int queue_count = state->device.graphics_queue.index == state->device.present_queue.index ? 1 : 2;
+    unsigned int families[] = {
+        state->device.graphics_queue.index,
+        state->device.present_queue.index,
+        state->device.transfer_queue.index
+    };
+
+    VkDeviceQueueCreateInfo queue_infos[sizeof(families) / sizeof(families[0])];
+    unsigned int queue_count = 0;
+
+    for (unsigned int i = 0; i < sizeof(families) / sizeof(families[0]); ++i) {
+        bool duplicate = false;
+        for (unsigned int j = 0; j < queue_count; ++j) {
+            if (queue_infos[j].queueFamilyIndex == families[i]) {
+                duplicate = true;
+            }
+        }
 
-    VkDeviceQueueCreateInfo* queue_infos = (VkDeviceQueueCreateInfo*)calloc(queue_count, sizeof(VkDeviceQueueCreateInfo));
-    queue_infos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queue_infos[0].pNext = NULL;
-    queue_infos[0].flags = 0;
-    queue_infos[0].queueFamilyIndex = state->device.graphics_queue.index;
-    queue_infos[0].queueCount = 1;
-    queue_infos[0].pQueuePriorities = queue_priority;
+        if (duplicate) {
+            continue;
+        }
 
-    if (queue_count == 2) {
-        queue_infos[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_infos[1].pNext = NULL;
-        queue_infos[1].flags = 0;
-        queue_infos[1].queueFamilyIndex = state->device.present_queue.index;
-        queue_infos[1].queueCount = 1;
-        queue_infos[1].pQueuePriorities = queue_priority;
+        queue_infos[queue_count].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_infos[queue_count].pNext = NULL;
+        queue_infos[queue_count].flags = 0;
+        queue_infos[queue_count].queueFamilyIndex = families[i];
+        queue_infos[queue_count].queueCount = 1;
+        queue_infos[queue_count].pQueuePriorities = queue_priority;
+        queue_count += 1;
     }
 
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(state->device.physical_device, &supported_features);
+
     VkPhysicalDeviceFeatures features = {0};
     features.samplerAnisotropy = VK_TRUE;
+    features.textureCompressionBC = supported_features.textureCompressionBC;
+
+    state->device.texture_compression_bc = supported_features.textureCompressionBC == VK_TRUE;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(state->device.physical_device, &properties);
+
+    VkPhysicalDeviceVulkan13Features supported_features13 = {0};
+    supported_features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    VkPhysicalDeviceVulkan12Features supported_features12 = {0};
+    supported_features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    supported_features12.pNext = properties.apiVersion >= VK_API_VERSION_1_3 ? &supported_features13 : NULL;
+
+    VkPhysicalDeviceFeatures2 supported_features2 = {0};
+    supported_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supported_features2.pNext = &supported_features12;
+
+    if (properties.apiVersion >= VK_API_VERSION_1_2) {
+        vkGetPhysicalDeviceFeatures2(state->device.physical_device, &supported_features2);
+    }
+
+    unsigned int family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(state->device.physical_device, &family_count, NULL);
+    VkQueueFamilyProperties* family_properties = (VkQueueFamilyProperties*)calloc(family_count, sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(state->device.physical_device, &family_count, family_properties);
 
-    const char* extensions[] = {
+    bool graphics_compute = (family_properties[state->device.graphics_queue.index].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+    free(family_properties);
+
+    // gpu culling writes one indirect command per visible object with the object index as first instance
+    state->device.draw_indirect_count = graphics_compute && supported_features12.drawIndirectCount && supported_features.multiDrawIndirect && supported_features.drawIndirectFirstInstance;
+
+    if (state->gpu_culling && !state->device.draw_indirect_count) {
+        fprintf(stderr, "indirect count draws unsupported, culling on the cpu\n");
+        state->gpu_culling = false;
+    }
+
+    // bindless textures index a partially bound, update after bind array with a per instance index
+    state->device.descriptor_indexing = supported_features12.runtimeDescriptorArray && supported_features12.descriptorBindingPartiallyBound
+        && supported_features12.descriptorBindingSampledImageUpdateAfterBind && supported_features12.shaderSampledImageArrayNonUniformIndexing;
+
+    if (state->bindless && !state->device.descriptor_indexing) {
+        fprintf(stderr, "descriptor indexing unsupported, binding textures per set\n");
+        state->bindless = false;
+    }
+
+    if (state->bindless) {
+        VkPhysicalDeviceVulkan12Properties properties12 = {0};
+        properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties2 = {0};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &properties12;
+
+        vkGetPhysicalDeviceProperties2(state->device.physical_device, &properties2);
+
+        u32 limit = properties12.maxPerStageDescriptorUpdateAfterBindSampledImages < properties12.maxDescriptorSetUpdateAfterBindSampledImages
+            ? properties12.maxPerStageDescriptorUpdateAfterBindSampledImages : properties12.maxDescriptorSetUpdateAfterBindSampledImages;
+        state->device.max_bindless_textures = limit < TEXTURE_TABLE_SIZE ? limit : TEXTURE_TABLE_SIZE;
+    }
+
+    features.multiDrawIndirect = state->gpu_culling ? VK_TRUE : VK_FALSE;
+    features.drawIndirectFirstInstance = state->gpu_culling ? VK_TRUE : VK_FALSE;
+
+    VkPhysicalDeviceVulkan12Features features12 = {0};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.drawIndirectCount = state->gpu_culling ? VK_TRUE : VK_FALSE;
+    features12.timelineSemaphore = VK_TRUE;
+    features12.runtimeDescriptorArray = state->bindless ? VK_TRUE : VK_FALSE;
+    features12.descriptorBindingPartiallyBound = state->bindless ? VK_TRUE : VK_FALSE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = state->bindless ? VK_TRUE : VK_FALSE;
+    features12.shaderSampledImageArrayNonUniformIndexing = state->bindless ? VK_TRUE : VK_FALSE;
+
+    // dynamic rendering begins rendering straight on the image views, no render pass or framebuffers
+    state->device.dynamic_rendering = supported_features13.dynamicRendering == VK_TRUE;
+
+    VkPhysicalDeviceVulkan13Features features13 = {0};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    features13.dynamicRendering = VK_TRUE;
+
+    const char* required_extensions[] = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
         VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
         VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME
     };
 
+    const char* extensions[sizeof(required_extensions) / sizeof(required_extensions[0]) + 2];
+    unsigned int extension_count = 0;
+
+    // headless rendering never presents, so it skips the swapchain and ray tracing extensions
+    for (unsigned int i = 0; !state->headless && i < sizeof(required_extensions) / sizeof(required_extensions[0]); ++i) {
+        extensions[extension_count++] = required_extensions[i];
+    }
+
+    // present wait tells when a frame actually reached the display, for input latency
+    VkPhysicalDevicePresentWaitFeaturesKHR supported_present_wait = {0};
+    supported_present_wait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    VkPhysicalDevicePresentIdFeaturesKHR supported_present_id = {0};
+    supported_present_id.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    supported_present_id.pNext = &supported_present_wait;
+
+    bool present_wait_extensions = !state->headless && properties.apiVersion >= VK_API_VERSION_1_1
+        && device_extension_supported(state->device.physical_device, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+        && device_extension_supported(state->device.physical_device, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+    if (present_wait_extensions) {
+        supported_features2.pNext = &supported_present_id;
+        vkGetPhysicalDeviceFeatures2(state->device.physical_device, &supported_features2);
+    }
+
+    state->device.present_wait = present_wait_extensions && supported_present_id.presentId && supported_present_wait.presentWait;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {0};
+    present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    present_wait_features.presentWait = VK_TRUE;
+
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {0};
+    present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    present_id_features.presentId = VK_TRUE;
+    present_id_features.pNext = &present_wait_features;
+
+    void* features_chain = NULL;
+
+    if (state->device.present_wait) {
+        present_wait_features.pNext = features_chain;
+        features_chain = &present_id_features;
+        extensions[extension_count++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+        extensions[extension_count++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+    }
+
+    features12.pNext = features_chain;
+    features_chain = &features12;
+
+    if (state->device.dynamic_rendering) {
+        features13.pNext = features_chain;
+        features_chain = &features13;
+    }
+
     VkDeviceCreateInfo create_info;
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    create_info.pNext = NULL;
+    create_info.pNext = features_chain;
     create_info.flags = 0;
     create_info.queueCreateInfoCount = queue_count;
     create_info.pQueueCreateInfos = queue_infos;
     create_info.enabledLayerCount = 0;
     create_info.ppEnabledLayerNames = NULL;
-    create_info.enabledExtensionCount = sizeof(extensions) / sizeof(extensions[0]);
-    create_info.ppEnabledExtensionNames = extensions;
+    create_info.enabledExtensionCount = extension_count;
+    create_info.ppEnabledExtensionNames = extension_count > 0 ? extensions : NULL;
     create_info.pEnabledFeatures = &features;
 
     if (vkCreateDevice(state->device.physical_device, &create_info, NULL, &state->device.device) != VK_SUCCESS) {
@@ -392,6 +1010,7 @@ void create_device(application_state* state)
 
     vkGetDeviceQueue(state->device.device, state->device.graphics_queue.index, 0, &state->device.graphics_queue.queue);
     vkGetDeviceQueue(state->device.device, state->device.present_queue.index, 0, &state->device.present_queue.queue);
+    vkGetDeviceQueue(state->device.device, state->device.transfer_queue.index, 0, &state->device.transfer_queue.queue);
 }
 
 void destroy_device(application_state* state)
@@ -428,16 +1047,23 @@ void query_surface_capabilities(application_state* state)
     VkPresentModeKHR* present_modes = (VkPresentModeKHR*)calloc(present_mode_count, sizeof(VkPresentModeKHR));
     vkGetPhysicalDeviceSurfacePresentModesKHR(state->device.physical_device, state->surface.surface, &present_mode_count, present_modes);
 
+    // mailbox unless another mode was asked for, fifo is the one mode every surface supports
+    VkPresentModeKHR wanted = state->requested_present_mode != VK_PRESENT_MODE_MAX_ENUM_KHR ? state->requested_present_mode : VK_PRESENT_MODE_MAILBOX_KHR;
+
     bool preferred_present_mode = false;
     for (unsigned int i = 0; i < present_mode_count; ++i) {
-        if (present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-            state->surface.present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        if (present_modes[i] == wanted) {
+            state->surface.present_mode = wanted;
             preferred_present_mode = true;
             break;
         }
     }
 
     if (!preferred_present_mode) {
+        if (state->requested_present_mode != VK_PRESENT_MODE_MAX_ENUM_KHR) {
+            fprintf(stderr, "requested present mode unsupported, using fifo\n");
+        }
+
         state->surface.present_mode = VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -463,7 +1089,7 @@ void query_surface_capabilities(application_state* state)
     }
 }
 
-VkImageView create_image_view(application_state* state, VkImage image, VkFormat format)
+VkImageView create_image_view(application_state* state, VkImage image, VkFormat format, u32 mip_levels)
 {
     VkImageViewCreateInfo create_info;
     create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -478,7 +1104,7 @@ VkImageView create_image_view(application_state* state, VkImage image, VkFormat
     create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
     create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     create_info.subresourceRange.baseMipLevel = 0;
-    create_info.subresourceRange.levelCount = 1;
+    create_info.subresourceRange.levelCount = mip_levels;
     create_info.subresourceRange.baseArrayLayer = 0;
     create_info.subresourceRange.layerCount = 1;
 
@@ -490,11 +1116,26 @@ VkImageView create_image_view(application_state* state, VkImage image, VkFormat
     return image_view;
 }
 
+const char* present_mode_name(VkPresentModeKHR mode)
+{
+    switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+        default: return "other";
+    }
+}
+
 void create_swapchain(application_state* state)
 {
     query_surface_capabilities(state);
 
-    unsigned int image_count = state->surface.capabilities.minImageCount + 1;
+    unsigned int image_count = state->requested_image_count > 0 ? state->requested_image_count : state->surface.capabilities.minImageCount + 1;
+    if (image_count < state->surface.capabilities.minImageCount) {
+        image_count = state->surface.capabilities.minImageCount;
+    }
+
     if (state->surface.capabilities.maxImageCount > 0 && image_count > state->surface.capabilities.maxImageCount) {
         image_count = state->surface.capabilities.maxImageCount;
     }
@@ -530,7 +1171,7 @@ void create_swapchain(application_state* state)
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = state->surface.present_mode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    create_info.oldSwapchain = state->swapchain.swapchain;
 
     if (vkCreateSwapchainKHR(state->device.device, &create_info, NULL, &state->swapchain.swapchain) != VK_SUCCESS) {
         fprintf(stderr, "failed to create swapchain\n");
@@ -542,10 +1183,12 @@ void create_swapchain(application_state* state)
 
     state->swapchain.image_views = (VkImageView*)realloc(state->swapchain.image_views, sizeof(VkImageView) * image_count);
     for (unsigned int i = 0; i < image_count; ++i) {
-        state->swapchain.image_views[i] = create_image_view(state, state->swapchain.images[i], state->surface.format);
+        state->swapchain.image_views[i] = create_image_view(state, state->swapchain.images[i], state->surface.format, 1);
     }
 
     state->swapchain.image_count = image_count;
+
+    printf("swapchain: %u images, %s, %u frames in flight\n", image_count, present_mode_name(state->surface.present_mode), state->frames_in_flight);
 }
 
 void destroy_swapchain(application_state* state)
@@ -557,10 +1200,45 @@ void destroy_swapchain(application_state* state)
     vkDestroySwapchainKHR(state->device.device, state->swapchain.swapchain, NULL);
 }
 
+void create_offscreen_targets(application_state* state)
+{
+    state->surface.format = HEADLESS_FORMAT;
+    state->surface.color_space = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    state->surface.extent = (VkExtent2D){ HEADLESS_WIDTH, HEADLESS_HEIGHT };
+
+    unsigned int image_count = state->frames_in_flight;
+
+    state->offscreen_images = (image*)realloc(state->offscreen_images, sizeof(image) * image_count);
+    state->swapchain.images = (VkImage*)realloc(state->swapchain.images, sizeof(VkImage) * image_count);
+    state->swapchain.image_views = (VkImageView*)realloc(state->swapchain.image_views, sizeof(VkImageView) * image_count);
+
+    for (unsigned int i = 0; i < image_count; ++i) {
+        create_image(state, state->surface.extent.width, state->surface.extent.height, 1, state->surface.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->offscreen_images[i].image, &state->offscreen_images[i].allocation);
+
+        state->swapchain.images[i] = state->offscreen_images[i].image;
+        state->swapchain.image_views[i] = create_image_view(state, state->swapchain.images[i], state->surface.format, 1);
+    }
+
+    state->swapchain.swapchain = VK_NULL_HANDLE;
+    state->swapchain.image_count = image_count;
+}
+
+void destroy_offscreen_targets(application_state* state)
+{
+    for (unsigned int i = 0; i < state->swapchain.image_count; ++i) {
+        vkDestroyImageView(state->device.device, state->swapchain.image_views[i], NULL);
+        vkDestroyImage(state->device.device, state->offscreen_images[i].image, NULL);
+        memory_allocator_free(&state->allocator, &state->offscreen_images[i].allocation);
+    }
+}
+
 VkShaderModule compile_shader_file(const char* filepath, application_state* state)
 {
-    FILE* f;
-    fopen_s(&f, filepath, "rb");
+    FILE* f = fopen(filepath, "rb");
+    if (!f) {
+        fprintf(stderr, "failed to open shader file %s\n", filepath);
+        return VK_NULL_HANDLE;
+    }
 
     fseek(f, 0, SEEK_END);
     long fsize = ftell(f);
@@ -590,8 +1268,134 @@ VkShaderModule compile_shader_file(const char* filepath, application_state* stat
     return module;
 }
 
+u32 read_u32_le(const u8* bytes)
+{
+    return (u32)bytes[0] | (u32)bytes[1] << 8 | (u32)bytes[2] << 16 | (u32)bytes[3] << 24;
+}
+
+// rejects cache blobs written by another driver, device or driver version
+bool pipeline_cache_compatible(application_state* state, const u8* data, size_t size)
+{
+    const size_t header_size = 16 + VK_UUID_SIZE;
+
+    if (size < header_size) {
+        return false;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(state->device.physical_device, &properties);
+
+    if (read_u32_le(data) < header_size || read_u32_le(data) > size) {
+        return false;
+    }
+
+    if (read_u32_le(data + 4) != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        return false;
+    }
+
+    if (read_u32_le(data + 8) != properties.vendorID || read_u32_le(data + 12) != properties.deviceID) {
+        return false;
+    }
+
+    return memcmp(data + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void create_pipeline_cache(application_state* state)
+{
+    u8* data = NULL;
+    size_t size = 0;
+
+    FILE* f = fopen(PIPELINE_CACHE_PATH, "rb");
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        long fsize = ftell(f);
+        fseek(f, 0, SEEK_SET);
+
+        if (fsize > 0) {
+            data = (u8*)malloc(fsize);
+            size = fread(data, 1, fsize, f);
+        }
+
+        fclose(f);
+    }
+
+    if (data && !pipeline_cache_compatible(state, data, size)) {
+        printf("ignoring incompatible pipeline cache %s\n", PIPELINE_CACHE_PATH);
+        size = 0;
+    }
+
+    VkPipelineCacheCreateInfo create_info;
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.pNext = NULL;
+    create_info.flags = 0;
+    create_info.initialDataSize = size;
+    create_info.pInitialData = size > 0 ? data : NULL;
+
+    if (vkCreatePipelineCache(state->device.device, &create_info, NULL, &state->pipeline_cache) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create pipeline cache\n");
+    }
+
+    free(data);
+}
+
+void save_pipeline_cache(application_state* state)
+{
+    size_t size = 0;
+    if (vkGetPipelineCacheData(state->device.device, state->pipeline_cache, &size, NULL) != VK_SUCCESS || size == 0) {
+        return;
+    }
+
+    void* data = malloc(size);
+    if (vkGetPipelineCacheData(state->device.device, state->pipeline_cache, &size, data) != VK_SUCCESS) {
+        free(data);
+        return;
+    }
+
+    // write a temporary file and rename it over the old cache so a crash never leaves a torn file behind
+    const char* temporary_path = PIPELINE_CACHE_PATH ".tmp";
+
+    FILE* f = fopen(temporary_path, "wb");
+    if (!f) {
+        fprintf(stderr, "failed to write pipeline cache %s\n", temporary_path);
+        free(data);
+        return;
+    }
+
+    bool written = fwrite(data, 1, size, f) == size;
+    written = fclose(f) == 0 && written;
+
+    free(data);
+
+    if (!written) {
+        fprintf(stderr, "failed to write pipeline cache %s\n", temporary_path);
+        remove(temporary_path);
+        return;
+    }
+
+#ifdef _WIN32
+    // rename does not replace an existing file on windows
+    remove(PIPELINE_CACHE_PATH);
+#endif
+
+    if (rename(temporary_path, PIPELINE_CACHE_PATH) != 0) {
+        fprintf(stderr, "failed to replace pipeline cache %s\n", PIPELINE_CACHE_PATH);
+        remove(temporary_path);
+    }
+}
+
+void destroy_pipeline_cache(application_state* state)
+{
+    save_pipeline_cache(state);
+    vkDestroyPipelineCache(state->device.device, state->pipeline_cache, NULL);
+}
+
 void create_render_pass(application_state* state)
 {
+    if (state->device.dynamic_rendering) {
+        state->render_pass = VK_NULL_HANDLE;
+        return;
+    }
+
     VkAttachmentDescription color_attachment;
     color_attachment.flags = 0;
     color_attachment.format = state->surface.format;
@@ -601,7 +1405,7 @@ void create_render_pass(application_state* state)
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color_attachment.finalLayout = state->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference color_attachment_reference;
     color_attachment_reference.attachment = 0;
@@ -651,7 +1455,11 @@ void destroy_render_pass(application_state* state)
 
 void create_framebuffers(application_state* state)
 {
-    state->framebuffers = (VkFramebuffer*)realloc(state->framebuffers, sizeof(VkFramebuffer) * state->swapchain.image_count);
+    if (state->device.dynamic_rendering) {
+        return;
+    }
+
+    state->framebuffers = (VkFramebuffer*)realloc(state->framebuffers, sizeof(VkFramebuffer) * state->swapchain.image_count);
 
     for (unsigned int i = 0; i < state->swapchain.image_count; ++i) {
         VkFramebufferCreateInfo create_info;
@@ -673,7 +1481,7 @@ void create_framebuffers(application_state* state)
 
 void destroy_framebuffers(application_state* state)
 {
-    for (unsigned int i = 0; i < state->swapchain.image_count; ++i) {
+    for (unsigned int i = 0; i < state->swapchain.image_count && state->framebuffers != NULL; ++i) {
         vkDestroyFramebuffer(state->device.device, state->framebuffers[i], NULL);
     }
 }
@@ -682,7 +1490,7 @@ void create_descriptor_set_layout(application_state* state)
 {
     VkDescriptorSetLayoutBinding ubo_layout_binding;
     ubo_layout_binding.binding = 0;
-    ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     ubo_layout_binding.descriptorCount = 1;
     ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     ubo_layout_binding.pImmutableSamplers = NULL;
@@ -694,32 +1502,176 @@ void create_descriptor_set_layout(application_state* state)
     sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     sampler_layout_binding.pImmutableSamplers = NULL;
 
-    VkDescriptorSetLayoutBinding bindings[2] = {
+    VkDescriptorSetLayoutBinding instance_layout_binding;
+    instance_layout_binding.binding = 2;
+    instance_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    instance_layout_binding.descriptorCount = 1;
+    instance_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    instance_layout_binding.pImmutableSamplers = NULL;
+
+    VkDescriptorSetLayoutBinding bindings[3] = {
         ubo_layout_binding,
+        instance_layout_binding,
         sampler_layout_binding
     };
 
-    VkDescriptorSetLayoutCreateInfo create_info;
-    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    create_info.pNext = NULL;
-    create_info.flags = 0;
-    create_info.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
-    create_info.pBindings = bindings;
+    // bindless mode samples from the texture table in set 1 instead of binding 1
+    state->descriptor_set_layout = descriptor_layout_cache_get(&state->layouts, bindings, state->bindless ? 2 : 3, 0, NULL);
+}
+
+// layouts are shared through the cache, which owns and destroys them
+void create_descriptor_layout_cache(application_state* state)
+{
+    descriptor_layout_cache_create(&state->layouts, state->device.device);
+}
+
+void destroy_descriptor_layout_cache(application_state* state)
+{
+    descriptor_layout_cache_destroy(&state->layouts);
+}
+
+// the table is written while frames using it are in flight, so its bindings are update after bind and partially bound.
+// that needs an update after bind pool of its own, the shared descriptor allocator has none
+void create_texture_table(application_state* state)
+{
+    if (!state->bindless) {
+        return;
+    }
+
+    texture_table* table = &state->textures;
+    table->capacity = state->device.max_bindless_textures;
+    table->texture_count = 0;
+    table->sampler_count = 0;
+
+    VkDescriptorSetLayoutBinding bindings[2];
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[0].descriptorCount = table->capacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[0].pImmutableSamplers = NULL;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[1].descriptorCount = TEXTURE_TABLE_SAMPLERS;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].pImmutableSamplers = NULL;
+
+    VkDescriptorBindingFlags binding_flags[2] = {
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+    };
+
+    table->layout = descriptor_layout_cache_get(&state->layouts, bindings, sizeof(bindings) / sizeof(bindings[0]), VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, binding_flags);
+
+    VkDescriptorPoolSize pool_size[2];
+    pool_size[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    pool_size[0].descriptorCount = table->capacity;
+
+    pool_size[1].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    pool_size[1].descriptorCount = TEXTURE_TABLE_SAMPLERS;
+
+    VkDescriptorPoolCreateInfo pool_info;
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.pNext = NULL;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = sizeof(pool_size) / sizeof(pool_size[0]);
+    pool_info.pPoolSizes = pool_size;
+
+    if (vkCreateDescriptorPool(state->device.device, &pool_info, NULL, &table->pool) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create texture table pool\n");
+    }
+
+    VkDescriptorSetAllocateInfo allocate_info;
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.pNext = NULL;
+    allocate_info.descriptorPool = table->pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &table->layout;
 
-    if (vkCreateDescriptorSetLayout(state->device.device, &create_info, NULL, &state->descriptor_set_layout) != VK_SUCCESS) {
-        fprintf(stderr, "failed to create descriptor set layout\n");
+    if (vkAllocateDescriptorSets(state->device.device, &allocate_info, &table->set) != VK_SUCCESS) {
+        fprintf(stderr, "failed to allocate texture table\n");
     }
+
+    printf("bindless texture table: %u textures, %u samplers\n", table->capacity, TEXTURE_TABLE_SAMPLERS);
 }
 
-void destroy_descriptor_set_layout(application_state* state)
+void destroy_texture_table(application_state* state)
 {
-    vkDestroyDescriptorSetLayout(state->device.device, state->descriptor_set_layout, NULL);
+    if (!state->bindless) {
+        return;
+    }
+
+    vkDestroyDescriptorPool(state->device.device, state->textures.pool, NULL);
 }
 
-void create_graphics_pipeline(application_state* state)
+void write_texture_table(application_state* state, u32 binding, u32 index, VkDescriptorType type, const VkDescriptorImageInfo* image_info)
+{
+    VkWriteDescriptorSet write;
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.pNext = NULL;
+    write.dstSet = state->textures.set;
+    write.dstBinding = binding;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pImageInfo = image_info;
+    write.pBufferInfo = NULL;
+    write.pTexelBufferView = NULL;
+
+    vkUpdateDescriptorSets(state->device.device, 1, &write, 0, NULL);
+}
+
+// returns the index shaders sample the view through, the view must stay alive as long as the table
+u32 register_texture(application_state* state, VkImageView view)
+{
+    texture_table* table = &state->textures;
+
+    if (table->texture_count == table->capacity) {
+        fprintf(stderr, "texture table full, %u textures\n", table->capacity);
+        return 0;
+    }
+
+    VkDescriptorImageInfo image_info;
+    image_info.sampler = VK_NULL_HANDLE;
+    image_info.imageView = view;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    write_texture_table(state, 0, table->texture_count, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &image_info);
+
+    return table->texture_count++;
+}
+
+u32 register_sampler(application_state* state, VkSampler sampler)
+{
+    texture_table* table = &state->textures;
+
+    if (table->sampler_count == TEXTURE_TABLE_SAMPLERS) {
+        fprintf(stderr, "texture table full, %u samplers\n", TEXTURE_TABLE_SAMPLERS);
+        return 0;
+    }
+
+    VkDescriptorImageInfo image_info;
+    image_info.sampler = sampler;
+    image_info.imageView = VK_NULL_HANDLE;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    write_texture_table(state, 1, table->sampler_count, VK_DESCRIPTOR_TYPE_SAMPLER, &image_info);
+
+    return table->sampler_count++;
+}
+
+// builds a pipeline with the current layout from the spir-v on disk, also called on the shader reload thread
+VkPipeline build_graphics_pipeline(application_state* state, VkFormat format, VkRenderPass render_pass)
 {
     VkShaderModule vert_module = compile_shader_file("shaders/shader.vert.spv", state);
-    VkShaderModule frag_module = compile_shader_file("shaders/shader.frag.spv", state);
+    VkShaderModule frag_module = compile_shader_file(state->bindless ? "shaders/bindless.frag.spv" : "shaders/shader.frag.spv", state);
+
+    if (vert_module == VK_NULL_HANDLE || frag_module == VK_NULL_HANDLE) {
+        vkDestroyShaderModule(state->device.device, frag_module, NULL);
+        vkDestroyShaderModule(state->device.device, vert_module, NULL);
+        return VK_NULL_HANDLE;
+    }
 
     VkPipelineShaderStageCreateInfo shader_stages[2];
     shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -753,22 +1705,22 @@ void create_graphics_pipeline(application_state* state)
     VkVertexInputAttributeDescription vertex_attributes_description[3];
     vertex_attributes_description[0].location = 0;
     vertex_attributes_description[0].binding = 0;
-    vertex_attributes_description[0].format = VK_FORMAT_R32G32_SFLOAT;
-    vertex_attributes_description[0].offset = offsetof(vertex, position);
+    vertex_attributes_description[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    vertex_attributes_description[0].offset = offsetof(mesh_vertex, position);
 
     vertex_attributes_description[1].location = 1;
     vertex_attributes_description[1].binding = 0;
     vertex_attributes_description[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertex_attributes_description[1].offset = offsetof(vertex, color);
+    vertex_attributes_description[1].offset = offsetof(mesh_vertex, color);
 
     vertex_attributes_description[2].location = 2;
     vertex_attributes_description[2].binding = 0;
     vertex_attributes_description[2].format = VK_FORMAT_R32G32_SFLOAT;
-    vertex_attributes_description[2].offset = offsetof(vertex, tex_coord);
+    vertex_attributes_description[2].offset = offsetof(mesh_vertex, tex_coord);
 
     VkVertexInputBindingDescription vertex_binding_description;
     vertex_binding_description.binding = 0;
-    vertex_binding_description.stride = sizeof(vertex);
+    vertex_binding_description.stride = sizeof(mesh_vertex);
     vertex_binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info;
@@ -787,26 +1739,15 @@ void create_graphics_pipeline(application_state* state)
     input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     input_assembly_info.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = state->surface.extent.width;
-    viewport.height = state->surface.extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor;
-    scissor.offset = (VkOffset2D){0, 0};
-    scissor.extent = state->surface.extent;
-
+    // viewport and scissor are dynamic, so the pipeline does not depend on the swapchain extent
     VkPipelineViewportStateCreateInfo viewport_info;
     viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_info.pNext = NULL;
     viewport_info.flags = 0;
     viewport_info.viewportCount = 1;
-    viewport_info.pViewports = &viewport;
+    viewport_info.pViewports = NULL;
     viewport_info.scissorCount = 1;
-    viewport_info.pScissors = &scissor;
+    viewport_info.pScissors = NULL;
 
     VkPipelineRasterizationStateCreateInfo rasterization_info;
     rasterization_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -857,22 +1798,18 @@ void create_graphics_pipeline(application_state* state)
     color_blend_info.blendConstants[2] = 0.0f;
     color_blend_info.blendConstants[3] = 0.0f;
 
-    VkPipelineLayoutCreateInfo layout_info;
-    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    layout_info.pNext = NULL;
-    layout_info.flags = 0;
-    layout_info.setLayoutCount = 1;
-    layout_info.pSetLayouts = &state->descriptor_set_layout;
-    layout_info.pushConstantRangeCount = 0;
-    layout_info.pPushConstantRanges = NULL;
-
-    if (vkCreatePipelineLayout(state->device.device, &layout_info, NULL, &state->graphics_pipeline.layout) != VK_SUCCESS) {
-        fprintf(stderr, "failed to create pipeline layout\n");
-    }
+    VkPipelineRenderingCreateInfo rendering_info;
+    rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering_info.pNext = NULL;
+    rendering_info.viewMask = 0;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &format;
+    rendering_info.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    rendering_info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
 
     VkGraphicsPipelineCreateInfo pipeline_info;
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_info.pNext = NULL;
+    pipeline_info.pNext = state->device.dynamic_rendering ? &rendering_info : NULL;
     pipeline_info.flags = 0;
     pipeline_info.stageCount = sizeof(shader_stages) / sizeof(shader_stages[0]);
     pipeline_info.pStages = shader_stages;
@@ -886,17 +1823,41 @@ void create_graphics_pipeline(application_state* state)
     pipeline_info.pColorBlendState = &color_blend_info;
     pipeline_info.pDynamicState = &dynamic_state_info;
     pipeline_info.layout = state->graphics_pipeline.layout;
-    pipeline_info.renderPass = state->render_pass;
+    pipeline_info.renderPass = render_pass;
     pipeline_info.subpass = 0;
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.basePipelineIndex = -1;
 
-    if (vkCreateGraphicsPipelines(state->device.device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &state->graphics_pipeline.pipeline) != VK_SUCCESS) {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    if (vkCreateGraphicsPipelines(state->device.device, state->pipeline_cache, 1, &pipeline_info, NULL, &pipeline) != VK_SUCCESS) {
         fprintf(stderr, "failed to create graphics pipeline\n");
     }
 
     vkDestroyShaderModule(state->device.device, frag_module, NULL);
     vkDestroyShaderModule(state->device.device, vert_module, NULL);
+
+    return pipeline;
+}
+
+void create_graphics_pipeline(application_state* state)
+{
+    VkPipelineLayoutCreateInfo layout_info;
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.pNext = NULL;
+    layout_info.flags = 0;
+    VkDescriptorSetLayout set_layouts[2] = {state->descriptor_set_layout, state->textures.layout};
+
+    layout_info.setLayoutCount = state->bindless ? 2 : 1;
+    layout_info.pSetLayouts = set_layouts;
+    layout_info.pushConstantRangeCount = 0;
+    layout_info.pPushConstantRanges = NULL;
+
+    if (vkCreatePipelineLayout(state->device.device, &layout_info, NULL, &state->graphics_pipeline.layout) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create pipeline layout\n");
+    }
+
+    state->graphics_pipeline.pipeline = build_graphics_pipeline(state, state->surface.format, state->render_pass);
 }
 
 void destroy_graphics_pipeline(application_state* state)
@@ -905,187 +1866,845 @@ void destroy_graphics_pipeline(application_state* state)
     vkDestroyPipelineLayout(state->device.device, state->graphics_pipeline.layout, NULL);
 }
 
+VkDescriptorSetLayoutBinding storage_binding(u32 binding, VkDescriptorType type)
+{
+    VkDescriptorSetLayoutBinding layout_binding;
+    layout_binding.binding = binding;
+    layout_binding.descriptorType = type;
+    layout_binding.descriptorCount = 1;
+    layout_binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layout_binding.pImmutableSamplers = NULL;
+
+    return layout_binding;
+}
+
+void create_cull_pipeline(application_state* state)
+{
+    if (!state->gpu_culling) {
+        return;
+    }
+
+    // per frame instances, static objects, per frame draw commands and draw count
+    VkDescriptorSetLayoutBinding bindings[4] = {
+        storage_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC),
+        storage_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+        storage_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC),
+        storage_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+    };
+
+    state->cull_set_layout = descriptor_layout_cache_get(&state->layouts, bindings, sizeof(bindings) / sizeof(bindings[0]), 0, NULL);
+
+    VkPushConstantRange push_constant_range;
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(cull_constants);
+
+    VkPipelineLayoutCreateInfo layout_info;
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.pNext = NULL;
+    layout_info.flags = 0;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &state->cull_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+
+    if (vkCreatePipelineLayout(state->device.device, &layout_info, NULL, &state->cull_pipeline.layout) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create cull pipeline layout\n");
+    }
+
+    state->cull_pipeline.pipeline = build_cull_pipeline(state);
+}
+
+// like build_graphics_pipeline, with the current cull layout
+VkPipeline build_cull_pipeline(application_state* state)
+{
+    VkShaderModule compute_module = compile_shader_file("shaders/cull.comp.spv", state);
+
+    if (compute_module == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+    }
+
+    VkComputePipelineCreateInfo pipeline_info;
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.pNext = NULL;
+    pipeline_info.flags = 0;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.pNext = NULL;
+    pipeline_info.stage.flags = 0;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = compute_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.stage.pSpecializationInfo = NULL;
+    pipeline_info.layout = state->cull_pipeline.layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = -1;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    if (vkCreateComputePipelines(state->device.device, state->pipeline_cache, 1, &pipeline_info, NULL, &pipeline) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create cull pipeline\n");
+    }
+
+    vkDestroyShaderModule(state->device.device, compute_module, NULL);
+
+    return pipeline;
+}
+
+void destroy_cull_pipeline(application_state* state)
+{
+    if (!state->gpu_culling) {
+        return;
+    }
+
+    vkDestroyPipeline(state->device.device, state->cull_pipeline.pipeline, NULL);
+    vkDestroyPipelineLayout(state->device.device, state->cull_pipeline.layout, NULL);
+}
+
+// pools are reset whole once the timeline has passed their frame, so no buffer needs individual reset
 void create_command_pool(application_state* state)
 {
     VkCommandPoolCreateInfo pool_info;
     pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     pool_info.pNext = NULL;
-    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
     pool_info.queueFamilyIndex = state->device.graphics_queue.index;
 
-    if (vkCreateCommandPool(state->device.device, &pool_info, NULL, &state->command_pool) != VK_SUCCESS) {
-        fprintf(stderr, "failed to create command pool\n");
+    state->command_pools = (VkCommandPool*)calloc(state->frames_in_flight, sizeof(VkCommandPool));
+    state->record_slices = (record_slice*)calloc(state->record_thread_count, sizeof(record_slice));
+
+    for (u32 i = 0; i < state->frames_in_flight; ++i) {
+        if (vkCreateCommandPool(state->device.device, &pool_info, NULL, &state->command_pools[i]) != VK_SUCCESS) {
+            fprintf(stderr, "failed to create command pool\n");
+        }
+    }
+
+    // a command pool must only be used from one thread at a time, so every slice owns its own
+    for (u32 slice = 0; slice < state->record_thread_count; ++slice) {
+        state->record_slices[slice].command_pools = (VkCommandPool*)calloc(state->frames_in_flight, sizeof(VkCommandPool));
+
+        for (u32 i = 0; i < state->frames_in_flight; ++i) {
+            if (vkCreateCommandPool(state->device.device, &pool_info, NULL, &state->record_slices[slice].command_pools[i]) != VK_SUCCESS) {
+                fprintf(stderr, "failed to create command pool\n");
+            }
+        }
     }
+
+    // the main thread records a slice as well
+    task_pool_create(&state->recorder, state->record_thread_count - 1);
 }
 
 void destroy_command_pool(application_state* state)
 {
-    vkDestroyCommandPool(state->device.device, state->command_pool, NULL);
+    task_pool_destroy(&state->recorder);
+
+    for (u32 slice = 0; slice < state->record_thread_count; ++slice) {
+        for (u32 i = 0; i < state->frames_in_flight; ++i) {
+            vkDestroyCommandPool(state->device.device, state->record_slices[slice].command_pools[i], NULL);
+        }
+
+        free(state->record_slices[slice].command_buffers);
+        free(state->record_slices[slice].command_pools);
+    }
+
+    for (u32 i = 0; i < state->frames_in_flight; ++i) {
+        vkDestroyCommandPool(state->device.device, state->command_pools[i], NULL);
+    }
+
+    free(state->record_slices);
+    free(state->command_pools);
 }
 
 void allocate_command_buffer(application_state* state)
 {
-    state->command_buffers = (VkCommandBuffer*)calloc(MAX_FRAMES_IN_FLIGHT, sizeof(VkCommandBuffer));
+    state->command_buffers = (VkCommandBuffer*)calloc(state->frames_in_flight, sizeof(VkCommandBuffer));
 
     VkCommandBufferAllocateInfo allocate_info;
     allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocate_info.pNext = NULL;
-    allocate_info.commandPool = state->command_pool;
     allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocate_info.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+    allocate_info.commandBufferCount = 1;
 
-    if (vkAllocateCommandBuffers(state->device.device, &allocate_info, state->command_buffers) != VK_SUCCESS) {
-        fprintf(stderr, "failed to allocate command buffer\n");
+    for (u32 i = 0; i < state->frames_in_flight; ++i) {
+        allocate_info.commandPool = state->command_pools[i];
+
+        if (vkAllocateCommandBuffers(state->device.device, &allocate_info, &state->command_buffers[i]) != VK_SUCCESS) {
+            fprintf(stderr, "failed to allocate command buffer\n");
+        }
+    }
+
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+    for (u32 slice = 0; slice < state->record_thread_count; ++slice) {
+        record_slice* record = &state->record_slices[slice];
+        record->command_buffers = (VkCommandBuffer*)calloc(state->frames_in_flight, sizeof(VkCommandBuffer));
+
+        for (u32 i = 0; i < state->frames_in_flight; ++i) {
+            allocate_info.commandPool = record->command_pools[i];
+
+            if (vkAllocateCommandBuffers(state->device.device, &allocate_info, &record->command_buffers[i]) != VK_SUCCESS) {
+                fprintf(stderr, "failed to allocate secondary command buffer\n");
+            }
+        }
     }
 }
 
 void create_sync_objects(application_state* state)
 {
-    state->image_available_semaphores = (VkSemaphore*)calloc(MAX_FRAMES_IN_FLIGHT, sizeof(VkSemaphore));
-    state->render_finished_semaphores = (VkSemaphore*)calloc(MAX_FRAMES_IN_FLIGHT, sizeof(VkSemaphore));
-    state->in_flight_fences = (VkFence*)calloc(MAX_FRAMES_IN_FLIGHT, sizeof(VkFence));
+    state->image_available_semaphores = (VkSemaphore*)calloc(state->frames_in_flight, sizeof(VkSemaphore));
+    state->render_finished_semaphores = (VkSemaphore*)calloc(state->frames_in_flight, sizeof(VkSemaphore));
+    state->frame_values = (u64*)calloc(state->frames_in_flight, sizeof(u64));
 
+    // acquire and present only take binary semaphores, everything else waits on the timeline
     VkSemaphoreCreateInfo semaphore_info;
     semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semaphore_info.pNext = NULL;
     semaphore_info.flags = 0;
 
-    VkFenceCreateInfo fence_info;
-    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_info.pNext = NULL;
-    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+    for (u32 i = 0; i < state->frames_in_flight; ++i) {
         vkCreateSemaphore(state->device.device, &semaphore_info, NULL, &state->image_available_semaphores[i]);
         vkCreateSemaphore(state->device.device, &semaphore_info, NULL, &state->render_finished_semaphores[i]);
-        vkCreateFence(state->device.device, &fence_info, NULL, &state->in_flight_fences[i]);
     }
+
+    VkSemaphoreTypeCreateInfo type_info;
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.pNext = NULL;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    semaphore_info.pNext = &type_info;
+
+    if (vkCreateSemaphore(state->device.device, &semaphore_info, NULL, &state->timeline) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create timeline semaphore\n");
+    }
+
+    state->timeline_value = 0;
 }
 
-void destroy_sync_objects(application_state* state)
+// every submission that signals the timeline takes the next value, in submission order on the graphics queue
+u64 next_timeline_value(application_state* state)
 {
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        vkDestroyFence(state->device.device, state->in_flight_fences[i], NULL);
-        vkDestroySemaphore(state->device.device, state->render_finished_semaphores[i], NULL);
-        vkDestroySemaphore(state->device.device, state->image_available_semaphores[i], NULL);
-    }
+    state->timeline_value += 1;
+    return state->timeline_value;
 }
 
-void record_command_buffer(VkCommandBuffer command_buffer, unsigned int index, application_state* state)
+bool timeline_reached(application_state* state, u64 value)
 {
-    VkCommandBufferBeginInfo begin_info;
-    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    begin_info.pNext = NULL;
-    begin_info.flags = 0;
-    begin_info.pInheritanceInfo = NULL;
+    u64 completed = 0;
+    vkGetSemaphoreCounterValue(state->device.device, state->timeline, &completed);
+    return completed >= value;
+}
 
-    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
-        fprintf(stderr, "failed to begin recording command buffer\n");
-    }
+void wait_timeline(application_state* state, u64 value)
+{
+    VkSemaphoreWaitInfo wait_info;
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.pNext = NULL;
+    wait_info.flags = 0;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &state->timeline;
+    wait_info.pValues = &value;
+
+    vkWaitSemaphores(state->device.device, &wait_info, UINT64_MAX);
+}
 
-    VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+void destroy_sync_objects(application_state* state)
+{
+    for (u32 i = 0; i < state->frames_in_flight; ++i) {
+        vkDestroySemaphore(state->device.device, state->render_finished_semaphores[i], NULL);
+        vkDestroySemaphore(state->device.device, state->image_available_semaphores[i], NULL);
+    }
 
-    VkRenderPassBeginInfo render_pass_info;
-    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_info.pNext = NULL;
-    render_pass_info.renderPass = state->render_pass;
-    render_pass_info.framebuffer = state->framebuffers[index];
-    render_pass_info.renderArea.offset = (VkOffset2D){0, 0};
-    render_pass_info.renderArea.extent = state->surface.extent;
-    render_pass_info.clearValueCount = 1;
-    render_pass_info.pClearValues = &clear_color;
+    vkDestroySemaphore(state->device.device, state->timeline, NULL);
+}
 
-    vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+void create_timestamp_queries(application_state* state)
+{
+    state->timestamps.query_pools = (VkQueryPool*)calloc(state->frames_in_flight, sizeof(VkQueryPool));
+    state->timestamps.query_counts = (u32*)calloc(state->frames_in_flight, sizeof(u32));
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, state->graphics_pipeline.pipeline);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(state->device.physical_device, &properties);
 
-    VkBuffer vertex_buffers[] = {state->vertex_buffer.buffer};
-    VkDeviceSize offsets[] = {0};
+    unsigned int queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(state->device.physical_device, &queue_family_count, NULL);
+    VkQueueFamilyProperties* queue_families = (VkQueueFamilyProperties*)calloc(queue_family_count, sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(state->device.physical_device, &queue_family_count, queue_families);
 
-    vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
-    vkCmdBindIndexBuffer(command_buffer, state->index_buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+    u32 valid_bits = queue_families[state->device.graphics_queue.index].timestampValidBits;
 
-    VkViewport viewport;
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = state->surface.extent.width;
-    viewport.height = state->surface.extent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+    free(queue_families);
 
-    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    state->timestamps.period = properties.limits.timestampPeriod;
+    state->timestamps.valid_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+    state->timestamps.supported = valid_bits > 0 && properties.limits.timestampPeriod > 0.0f;
 
-    VkRect2D scissor;
-    scissor.offset = (VkOffset2D){0, 0};
-    scissor.extent = state->surface.extent;
+    if (!state->timestamps.supported) {
+        fprintf(stderr, "graphics queue does not support timestamps, gpu timings disabled\n");
+        return;
+    }
 
-    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    VkQueryPoolCreateInfo create_info;
+    create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.pNext = NULL;
+    create_info.flags = 0;
+    create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    create_info.queryCount = TIMESTAMP_QUERY_COUNT;
+    create_info.pipelineStatistics = 0;
+
+    for (u32 i = 0; i < state->frames_in_flight; ++i) {
+        if (vkCreateQueryPool(state->device.device, &create_info, NULL, &state->timestamps.query_pools[i]) != VK_SUCCESS) {
+            fprintf(stderr, "failed to create timestamp query pool\n");
+            state->timestamps.supported = false;
+        }
+    }
+}
 
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, state->graphics_pipeline.layout, 0, 1, &state->descriptor_sets[state->current_frame], 0, NULL);
+void destroy_timestamp_queries(application_state* state)
+{
+    for (u32 i = 0; i < state->frames_in_flight; ++i) {
+        if (state->timestamps.query_pools[i] != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(state->device.device, state->timestamps.query_pools[i], NULL);
+        }
+    }
+}
 
-    // TODO: remove hardcoded 6 index count
-    vkCmdDrawIndexed(command_buffer, 6, 1, 0, 0, 0);
+void write_timestamp(application_state* state, VkCommandBuffer command_buffer, VkPipelineStageFlagBits stage, u32 query)
+{
+    if (!state->timestamps.supported) {
+        return;
+    }
 
-    vkCmdEndRenderPass(command_buffer);
+    vkCmdWriteTimestamp(command_buffer, stage, state->timestamps.query_pools[state->current_frame], query);
 
-    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-        fprintf(stderr, "failed to record command buffer\n");
+    if (query + 1 > state->timestamps.query_counts[state->current_frame]) {
+        state->timestamps.query_counts[state->current_frame] = query + 1;
     }
 }
 
-void draw_frame(application_state* state, f32 dt)
+// called once the timeline has passed the frame, so the results are read without stalling
+void collect_timestamps(application_state* state, u32 frame)
 {
-    vkWaitForFences(state->device.device, 1, &state->in_flight_fences[state->current_frame], VK_TRUE, UINT64_MAX);
+    u32 count = state->timestamps.query_counts[frame];
+    state->timestamps.query_counts[frame] = 0;
 
-    unsigned int image_index;
-    VkResult result = vkAcquireNextImageKHR(state->device.device, state->swapchain.swapchain, UINT64_MAX, state->image_available_semaphores[state->current_frame], VK_NULL_HANDLE, &image_index);
+    if (!state->timestamps.supported || count < TIMESTAMP_FIRST_DRAW) {
+        return;
+    }
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreate_swapchain(state);
+    u64 results[TIMESTAMP_QUERY_COUNT];
+    if (vkGetQueryPoolResults(state->device.device, state->timestamps.query_pools[frame], 0, count, sizeof(results), results, sizeof(u64), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
         return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        fprintf(stderr, "failed to acquire swapchain image\n");
     }
 
-    vkResetFences(state->device.device, 1, &state->in_flight_fences[state->current_frame]);
+    u64 render_pass = (results[TIMESTAMP_RENDER_PASS_END] - results[TIMESTAMP_RENDER_PASS_BEGIN]) & state->timestamps.valid_mask;
+    frame_stats_record(&state->stats, FRAME_STAGE_GPU_RENDER_PASS, (u64)((f64)render_pass * state->timestamps.period));
 
-    vkResetCommandBuffer(state->command_buffers[state->current_frame], 0);
-    record_command_buffer(state->command_buffers[state->current_frame], image_index, state);
+    for (u32 query = TIMESTAMP_FIRST_DRAW; query + 1 < count; query += 2) {
+        u64 draw = (results[query + 1] - results[query]) & state->timestamps.valid_mask;
+        frame_stats_record(&state->stats, FRAME_STAGE_GPU_DRAW, (u64)((f64)draw * state->timestamps.period));
+    }
+}
 
-    VkSemaphore wait_semaphores[] = {state->image_available_semaphores[state->current_frame]};
-    VkSemaphore signal_semaphores[] = {state->render_finished_semaphores[state->current_frame]};
-    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+void buffer_barrier(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags src_access, VkAccessFlags dst_access, VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+    VkBufferMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext = NULL;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
 
-    update_uniform_buffer(state, state->current_frame, dt);
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 1, &barrier, 0, NULL);
+}
 
-    VkSubmitInfo submit_info;
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.pNext = NULL;
-    submit_info.waitSemaphoreCount = sizeof(wait_semaphores) / sizeof(wait_semaphores[0]);
-    submit_info.pWaitSemaphores = wait_semaphores;
-    submit_info.pWaitDstStageMask = wait_stages;
-    submit_info.commandBufferCount = 1;
+void attachment_barrier(VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access, VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+    VkImageMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = NULL;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// the cull set is transient, allocated from the frame's pools and freed in bulk when the frame slot comes around
+VkDescriptorSet write_cull_descriptor_set(application_state* state)
+{
+    VkDescriptorSet set = descriptor_allocator_allocate(&state->descriptors, state->current_frame, state->cull_set_layout);
+    if (set == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+    }
+
+    // ranges cover one frame, the dynamic offsets pick the slice
+    VkDescriptorBufferInfo cull_infos[4] = {
+        {state->instance_buffer.buffer, 0, sizeof(instance_data) * state->instance_capacity},
+        {state->object_buffer.buffer, 0, sizeof(gpu_object) * state->instance_capacity},
+        {state->draw_command_buffer.buffer, 0, sizeof(VkDrawIndexedIndirectCommand) * state->instance_capacity},
+        {state->draw_count_buffer.buffer, 0, sizeof(u32)}
+    };
+
+    VkWriteDescriptorSet cull_writes[4];
+    for (u32 i = 0; i < 4; ++i) {
+        cull_writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        cull_writes[i].pNext = NULL;
+        cull_writes[i].dstSet = set;
+        cull_writes[i].dstBinding = i;
+        cull_writes[i].dstArrayElement = 0;
+        cull_writes[i].descriptorCount = 1;
+        cull_writes[i].descriptorType = i == 1 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        cull_writes[i].pImageInfo = NULL;
+        cull_writes[i].pBufferInfo = &cull_infos[i];
+        cull_writes[i].pTexelBufferView = NULL;
+    }
+
+    vkUpdateDescriptorSets(state->device.device, sizeof(cull_writes) / sizeof(cull_writes[0]), cull_writes, 0, NULL);
+
+    return set;
+}
+
+// frustum tests every object on the gpu and appends an indirect draw for each visible one
+void record_cull_pass(VkCommandBuffer command_buffer, application_state* state)
+{
+    VkDeviceSize command_offset = state->current_frame * state->draw_command_frame_size;
+    VkDeviceSize count_offset = state->current_frame * state->draw_count_frame_size;
+
+    vkCmdFillBuffer(command_buffer, state->draw_count_buffer.buffer, count_offset, sizeof(u32), 0);
+
+    buffer_barrier(command_buffer, state->draw_count_buffer.buffer, count_offset, sizeof(u32),
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    cull_constants constants;
+    cull_frustum frustum;
+    cull_frustum_extract(&frustum, state->view_projection);
+    memcpy(constants.planes, frustum.planes, sizeof(constants.planes));
+    constants.object_count = state->instance_count;
+
+    u32 dynamic_offsets[] = {
+        (u32)(state->current_frame * state->instance_frame_size),
+        (u32)command_offset,
+        (u32)count_offset
+    };
+
+    // without a set the count stays zero and nothing is drawn this frame
+    VkDescriptorSet cull_set = write_cull_descriptor_set(state);
+
+    if (cull_set != VK_NULL_HANDLE) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, state->cull_pipeline.pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, state->cull_pipeline.layout, 0, 1, &cull_set, sizeof(dynamic_offsets) / sizeof(dynamic_offsets[0]), dynamic_offsets);
+        vkCmdPushConstants(command_buffer, state->cull_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(command_buffer, (state->instance_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+    }
+
+    // the draw commands and their count are consumed as indirect arguments
+    buffer_barrier(command_buffer, state->draw_command_buffer.buffer, command_offset, state->draw_command_frame_size,
+        VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    buffer_barrier(command_buffer, state->draw_count_buffer.buffer, count_offset, sizeof(u32),
+        VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+}
+
+// records the draws of one slice into its secondary, called on the recording threads.
+// draw d covers instances [d * instance_count / draw_count, (d + 1) * instance_count / draw_count)
+void record_slice_commands(void* context, u32 slice)
+{
+    application_state* state = (application_state*)context;
+    record_slice* record = &state->record_slices[slice];
+    VkCommandBuffer command_buffer = record->command_buffers[state->current_frame];
+
+    vkResetCommandPool(state->device.device, record->command_pools[state->current_frame], 0);
+
+    VkCommandBufferInheritanceRenderingInfo rendering_info;
+    rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    rendering_info.pNext = NULL;
+    rendering_info.flags = 0;
+    rendering_info.viewMask = 0;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &state->surface.format;
+    rendering_info.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    rendering_info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+    rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance_info;
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.pNext = state->device.dynamic_rendering ? &rendering_info : NULL;
+    inheritance_info.renderPass = state->render_pass;
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = state->device.dynamic_rendering ? VK_NULL_HANDLE : state->framebuffers[state->record_image_index];
+    inheritance_info.occlusionQueryEnable = VK_FALSE;
+    inheritance_info.queryFlags = 0;
+    inheritance_info.pipelineStatistics = 0;
+
+    VkCommandBufferBeginInfo begin_info;
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.pNext = NULL;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        fprintf(stderr, "failed to begin recording secondary command buffer\n");
+    }
+
+    // secondaries inherit no state from the primary
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, state->graphics_pipeline.pipeline);
+
+    VkBuffer vertex_buffers[] = {state->vertex_buffer.buffer};
+    VkDeviceSize offsets[] = {0};
+
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, state->index_buffer.buffer, 0, state->index_type);
+
+    VkViewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = state->surface.extent.width;
+    viewport.height = state->surface.extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+    VkRect2D scissor;
+    scissor.offset = (VkOffset2D){0, 0};
+    scissor.extent = state->surface.extent;
+
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    // ordered by binding: camera uniforms, then this frame's slice of the instance buffer
+    u32 dynamic_offsets[] = {
+        state->camera_offset,
+        (u32)(state->current_frame * state->instance_frame_size)
+    };
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, state->graphics_pipeline.layout, 0, 1, &state->descriptor_set, sizeof(dynamic_offsets) / sizeof(dynamic_offsets[0]), dynamic_offsets);
+
+    // the table is bound once, instances pick their texture and sampler by index
+    if (state->bindless) {
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, state->graphics_pipeline.layout, 1, 1, &state->textures.set, 0, NULL);
+    }
+
+    // write_timestamp tracks the query count and is not thread safe, the primary accounts for these
+    u32 query = TIMESTAMP_FIRST_DRAW + 2 * slice;
+
+    if (state->timestamps.supported) {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, state->timestamps.query_pools[state->current_frame], query);
+    }
+
+    if (state->gpu_culling) {
+        vkCmdDrawIndexedIndirectCount(command_buffer,
+            state->draw_command_buffer.buffer, state->current_frame * state->draw_command_frame_size,
+            state->draw_count_buffer.buffer, state->current_frame * state->draw_count_frame_size,
+            state->instance_count, sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        u32 draw_count = state->draw_count < state->visible_count ? state->draw_count : state->visible_count;
+        u32 first_draw = (u32)((u64)slice * draw_count / state->record_slice_count);
+        u32 last_draw = (u32)((u64)(slice + 1) * draw_count / state->record_slice_count);
+
+        for (u32 draw = first_draw; draw < last_draw; ++draw) {
+            u32 first_instance = (u32)((u64)draw * state->visible_count / draw_count);
+            u32 end_instance = (u32)((u64)(draw + 1) * state->visible_count / draw_count);
+
+            vkCmdDrawIndexed(command_buffer, state->index_count, end_instance - first_instance, 0, 0, first_instance);
+        }
+    }
+
+    if (state->timestamps.supported) {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, state->timestamps.query_pools[state->current_frame], query + 1);
+    }
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        fprintf(stderr, "failed to record secondary command buffer\n");
+    }
+}
+
+// the render pass equivalent, its load and final layout transitions become explicit barriers
+void begin_dynamic_rendering(application_state* state, VkCommandBuffer command_buffer, u32 index, VkClearValue clear_color)
+{
+    // ordered after the acquire semaphore wait, which waits at color attachment output
+    attachment_barrier(command_buffer, state->swapchain.images[index], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    VkRenderingAttachmentInfo color_attachment;
+    color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    color_attachment.pNext = NULL;
+    color_attachment.imageView = state->swapchain.image_views[index];
+    color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+    color_attachment.resolveImageView = VK_NULL_HANDLE;
+    color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.clearValue = clear_color;
+
+    VkRenderingInfo rendering_info;
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    rendering_info.pNext = NULL;
+    rendering_info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    rendering_info.renderArea.offset = (VkOffset2D){0, 0};
+    rendering_info.renderArea.extent = state->surface.extent;
+    rendering_info.layerCount = 1;
+    rendering_info.viewMask = 0;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments = &color_attachment;
+    rendering_info.pDepthAttachment = NULL;
+    rendering_info.pStencilAttachment = NULL;
+
+    vkCmdBeginRendering(command_buffer, &rendering_info);
+}
+
+void end_dynamic_rendering(application_state* state, VkCommandBuffer command_buffer, u32 index)
+{
+    vkCmdEndRendering(command_buffer);
+
+    // present waits on the render finished semaphore, which covers every earlier stage
+    VkImageLayout final_layout = state->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    attachment_barrier(command_buffer, state->swapchain.images[index], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, final_layout, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+void record_command_buffer(VkCommandBuffer command_buffer, unsigned int index, application_state* state)
+{
+    VkCommandBufferBeginInfo begin_info;
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.pNext = NULL;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = NULL;
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        fprintf(stderr, "failed to begin recording command buffer\n");
+    }
+
+    if (state->timestamps.supported) {
+        vkCmdResetQueryPool(command_buffer, state->timestamps.query_pools[state->current_frame], 0, TIMESTAMP_QUERY_COUNT);
+    }
+
+    if (state->gpu_culling) {
+        record_cull_pass(command_buffer, state);
+    }
+
+    write_timestamp(state, command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, TIMESTAMP_RENDER_PASS_BEGIN);
+
+    // no more slices than draws, an empty secondary is pure overhead. draws cover the visible objects only
+    u32 draw_count = state->draw_count < state->visible_count ? state->draw_count : state->visible_count;
+    state->record_slice_count = state->record_thread_count < draw_count ? state->record_thread_count : draw_count;
+
+    // the gpu generated draws are one indirect call, a single slice records it
+    if (state->gpu_culling) {
+        state->record_slice_count = 1;
+    }
+    state->record_image_index = index;
+
+    task_pool_run(&state->recorder, record_slice_commands, state, state->record_slice_count);
+
+    VkCommandBuffer secondaries[MAX_RECORD_THREADS];
+    for (u32 slice = 0; slice < state->record_slice_count; ++slice) {
+        secondaries[slice] = state->record_slices[slice].command_buffers[state->current_frame];
+    }
+
+    if (state->timestamps.supported) {
+        u32 count = TIMESTAMP_FIRST_DRAW + 2 * state->record_slice_count;
+
+        if (count > state->timestamps.query_counts[state->current_frame]) {
+            state->timestamps.query_counts[state->current_frame] = count;
+        }
+    }
+
+    VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+    if (state->device.dynamic_rendering) {
+        begin_dynamic_rendering(state, command_buffer, index, clear_color);
+    } else {
+        VkRenderPassBeginInfo render_pass_info;
+        render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        render_pass_info.pNext = NULL;
+        render_pass_info.renderPass = state->render_pass;
+        render_pass_info.framebuffer = state->framebuffers[index];
+        render_pass_info.renderArea.offset = (VkOffset2D){0, 0};
+        render_pass_info.renderArea.extent = state->surface.extent;
+        render_pass_info.clearValueCount = 1;
+        render_pass_info.pClearValues = &clear_color;
+
+        vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    }
+
+    if (state->record_slice_count > 0) {
+        vkCmdExecuteCommands(command_buffer, state->record_slice_count, secondaries);
+    }
+
+    if (state->device.dynamic_rendering) {
+        end_dynamic_rendering(state, command_buffer, index);
+    } else {
+        vkCmdEndRenderPass(command_buffer);
+    }
+
+    write_timestamp(state, command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, TIMESTAMP_RENDER_PASS_END);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        fprintf(stderr, "failed to record command buffer\n");
+    }
+}
+
+void draw_frame(application_state* state, f32 dt)
+{
+    u64 frame_start = frame_clock_now();
+    u64 stage_start = frame_start;
+
+    wait_timeline(state, state->frame_values[state->current_frame]);
+
+    frame_stats_lap(&state->stats, FRAME_STAGE_FRAME_WAIT, &stage_start);
+
+    collect_timestamps(state, state->current_frame);
+    descriptor_allocator_reset(&state->descriptors, state->current_frame);
+    retire_uploads(state, false);
+    release_retired_swapchains(state, false);
+    update_shader_reload(state);
+
+    unsigned int image_index = state->current_frame;
+    VkResult result = VK_SUCCESS;
+
+    if (!state->headless) {
+        lock_swapchain(state);
+        result = vkAcquireNextImageKHR(state->device.device, state->swapchain.swapchain, UINT64_MAX, state->image_available_semaphores[state->current_frame], VK_NULL_HANDLE, &image_index);
+        unlock_swapchain(state);
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreate_swapchain(state);
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            fprintf(stderr, "failed to acquire swapchain image\n");
+        }
+
+        frame_stats_lap(&state->stats, FRAME_STAGE_ACQUIRE, &stage_start);
+    }
+
+    // this frame is the first to see any input that arrived since the last one
+    u64 input_time = state->input_time;
+    state->input_time = 0;
+
+    // the frame's uniform blocks are allocated before recording so their offsets can be bound
+    begin_uniform_frame(state, state->current_frame);
+    update_uniform_buffer(state);
+    update_instances(state, state->current_frame, dt);
+
+    vkResetCommandPool(state->device.device, state->command_pools[state->current_frame], 0);
+    record_command_buffer(state->command_buffers[state->current_frame], image_index, state);
+
+    VkSemaphore wait_semaphores[] = {state->image_available_semaphores[state->current_frame]};
+    VkSemaphore signal_semaphores[] = {state->timeline, state->render_finished_semaphores[state->current_frame]};
+    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+
+    // the value this frame signals is what the next use of its slot waits for
+    u64 frame_value = next_timeline_value(state);
+    u64 signal_values[] = {frame_value, 0};
+    state->frame_values[state->current_frame] = frame_value;
+
+    frame_stats_lap(&state->stats, FRAME_STAGE_RECORD, &stage_start);
+
+    VkTimelineSemaphoreSubmitInfo timeline_info;
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.pNext = NULL;
+    timeline_info.waitSemaphoreValueCount = 0;
+    timeline_info.pWaitSemaphoreValues = NULL;
+    timeline_info.signalSemaphoreValueCount = sizeof(signal_values) / sizeof(signal_values[0]);
+    timeline_info.pSignalSemaphoreValues = signal_values;
+
+    VkSubmitInfo submit_info;
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = sizeof(wait_semaphores) / sizeof(wait_semaphores[0]);
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+    submit_info.commandBufferCount = 1;
     submit_info.pCommandBuffers = &state->command_buffers[state->current_frame];
     submit_info.signalSemaphoreCount = sizeof(signal_semaphores) / sizeof(signal_semaphores[0]);
     submit_info.pSignalSemaphores = signal_semaphores;
 
-    if (vkQueueSubmit(state->device.graphics_queue.queue, 1, &submit_info, state->in_flight_fences[state->current_frame]) != VK_SUCCESS) {
+    if (state->headless) {
+        submit_info.waitSemaphoreCount = 0;
+        submit_info.pWaitSemaphores = NULL;
+        submit_info.pWaitDstStageMask = NULL;
+        submit_info.signalSemaphoreCount = 1;
+        timeline_info.signalSemaphoreValueCount = 1;
+    }
+
+    if (vkQueueSubmit(state->device.graphics_queue.queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
         fprintf(stderr, "failed to submit draw command buffer\n");
     }
 
+    state->frame_number += 1;
+
+    frame_stats_lap(&state->stats, FRAME_STAGE_SUBMIT, &stage_start);
+
+    if (state->headless) {
+        frame_stats_record(&state->stats, FRAME_STAGE_FRAME, stage_start - frame_start);
+        state->current_frame = (state->current_frame + 1) % state->frames_in_flight;
+        return;
+    }
+
     VkSwapchainKHR swapchains[] = {state->swapchain.swapchain};
 
     VkPresentInfoKHR present_info;
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     present_info.pNext = NULL;
-    present_info.waitSemaphoreCount = sizeof(signal_semaphores) / sizeof(signal_semaphores[0]);
-    present_info.pWaitSemaphores = signal_semaphores;
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &state->render_finished_semaphores[state->current_frame];
     present_info.swapchainCount = sizeof(swapchains) / sizeof(swapchains[0]);
     present_info.pSwapchains = swapchains;
     present_info.pImageIndices = &image_index;
     present_info.pResults = NULL;
 
+    u64 present_id = state->frame_number;
+
+    VkPresentIdKHR present_id_info;
+    present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    present_id_info.pNext = NULL;
+    present_id_info.swapchainCount = 1;
+    present_id_info.pPresentIds = &present_id;
+
+    if (state->device.present_wait) {
+        present_info.pNext = &present_id_info;
+    }
+
+    lock_swapchain(state);
     result = vkQueuePresentKHR(state->device.present_queue.queue, &present_info);
+    unlock_swapchain(state);
+
+    frame_stats_lap(&state->stats, FRAME_STAGE_PRESENT, &stage_start);
+
+    // without present wait the latency ends when the present is queued
+    if (input_time != 0 && !state->latency.running) {
+        frame_stats_record(&state->stats, FRAME_STAGE_INPUT_LATENCY, stage_start - input_time);
+    } else if (input_time != 0) {
+        latency_waiter* latency = &state->latency;
+
+        mtx_lock(&latency->lock);
+
+        if (latency->pending_count < MAX_LATENCY_SAMPLES) {
+            latency->pending[latency->pending_count++] = (latency_sample){ state->swapchain.swapchain, present_id, input_time };
+            cnd_signal(&latency->pending_added);
+        } else {
+            latency->dropped += 1;
+        }
+
+        mtx_unlock(&latency->lock);
+    }
+
+    collect_present_latency(state);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || state->framebuffer_resized) {
         state->framebuffer_resized = false;
@@ -1094,80 +2713,715 @@ void draw_frame(application_state* state, f32 dt)
         fprintf(stderr, "failed to present swapchain image\n");
     }
 
-    state->current_frame = (state->current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    frame_stats_record(&state->stats, FRAME_STAGE_FRAME, frame_clock_now() - frame_start);
+
+    state->current_frame = (state->current_frame + 1) % state->frames_in_flight;
+}
+
+// waits for the frames carrying input in present order, stamping each as soon as its present completes
+int latency_thread(void* context)
+{
+    application_state* state = (application_state*)context;
+    latency_waiter* latency = &state->latency;
+
+    mtx_lock(&latency->lock);
+
+    while (!latency->stop) {
+        if (latency->pending_count == 0) {
+            cnd_wait(&latency->pending_added, &latency->lock);
+            continue;
+        }
+
+        latency_sample* sample = &latency->pending[0];
+
+        VkResult result = vkWaitForPresentKHR(state->device.device, sample->swapchain, sample->present_id, LATENCY_WAIT_SLICE_NS);
+        u64 now = frame_clock_now();
+
+        if (result != VK_TIMEOUT) {
+            // an out of date swapchain never reports the present, the sample is dropped
+            if (result == VK_SUCCESS && latency->result_count < MAX_LATENCY_SAMPLES) {
+                latency->results[latency->result_count++] = now - sample->input_time;
+            } else {
+                latency->dropped += 1;
+            }
+
+            latency->pending_count -= 1;
+            memmove(latency->pending, latency->pending + 1, latency->pending_count * sizeof(latency_sample));
+        }
+
+        // acquire and present wait on the same lock, they go first
+        mtx_unlock(&latency->lock);
+        while (atomic_load_explicit(&latency->render_waiting, memory_order_acquire) > 0) {
+            thrd_yield();
+        }
+        mtx_lock(&latency->lock);
+    }
+
+    mtx_unlock(&latency->lock);
+
+    return 0;
+}
+
+void lock_swapchain(application_state* state)
+{
+    if (!state->latency.running) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&state->latency.render_waiting, 1, memory_order_acq_rel);
+    mtx_lock(&state->latency.lock);
+    atomic_fetch_sub_explicit(&state->latency.render_waiting, 1, memory_order_acq_rel);
+}
+
+void unlock_swapchain(application_state* state)
+{
+    if (state->latency.running) {
+        mtx_unlock(&state->latency.lock);
+    }
+}
+
+// records the latencies the waiter has finished
+void collect_present_latency(application_state* state)
+{
+    latency_waiter* latency = &state->latency;
+
+    if (!latency->running) {
+        return;
+    }
+
+    mtx_lock(&latency->lock);
+
+    for (u32 i = 0; i < latency->result_count; ++i) {
+        frame_stats_record(&state->stats, FRAME_STAGE_INPUT_LATENCY, latency->results[i]);
+    }
+
+    latency->result_count = 0;
+
+    mtx_unlock(&latency->lock);
+}
+
+void create_latency_waiter(application_state* state)
+{
+    if (!state->device.present_wait) {
+        return;
+    }
+
+    latency_waiter* latency = &state->latency;
+
+    if (mtx_init(&latency->lock, mtx_plain) != thrd_success) {
+        fprintf(stderr, "failed to create latency lock\n");
+        return;
+    }
+
+    if (cnd_init(&latency->pending_added) != thrd_success) {
+        fprintf(stderr, "failed to create latency condition\n");
+        mtx_destroy(&latency->lock);
+        return;
+    }
+
+    atomic_init(&latency->render_waiting, 0);
+
+    if (thrd_create(&latency->thread, latency_thread, state) != thrd_success) {
+        fprintf(stderr, "failed to start latency thread\n");
+        cnd_destroy(&latency->pending_added);
+        mtx_destroy(&latency->lock);
+        return;
+    }
+
+    latency->running = true;
+}
+
+void destroy_latency_waiter(application_state* state)
+{
+    latency_waiter* latency = &state->latency;
+
+    if (!latency->running) {
+        return;
+    }
+
+    mtx_lock(&latency->lock);
+    latency->stop = true;
+    cnd_signal(&latency->pending_added);
+    mtx_unlock(&latency->lock);
+
+    thrd_join(latency->thread, NULL);
+    latency->running = false;
+
+    cnd_destroy(&latency->pending_added);
+    mtx_destroy(&latency->lock);
+
+    if (latency->dropped > 0) {
+        printf("input latency: %u samples dropped\n", latency->dropped);
+    }
+}
+
+// frames submitted before the swapchain was retired may still use it, they are all done
+// once the timeline reaches the value of the last of them
+void release_retired_swapchains(application_state* state, bool all)
+{
+    u32 kept = 0;
+
+    for (u32 i = 0; i < state->retired_swapchain_count; ++i) {
+        retired_swapchain* retired = &state->retired_swapchains[i];
+
+        if (!all && !timeline_reached(state, retired->last_value)) {
+            state->retired_swapchains[kept++] = *retired;
+            continue;
+        }
+
+        for (u32 j = 0; j < retired->image_count; ++j) {
+            if (retired->framebuffers != NULL) {
+                vkDestroyFramebuffer(state->device.device, retired->framebuffers[j], NULL);
+            }
+            vkDestroyImageView(state->device.device, retired->image_views[j], NULL);
+        }
+
+        vkDestroySwapchainKHR(state->device.device, retired->swapchain, NULL);
+
+        if (retired->pipeline.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(state->device.device, retired->pipeline.pipeline, NULL);
+            vkDestroyPipelineLayout(state->device.device, retired->pipeline.layout, NULL);
+        }
+
+        if (retired->render_pass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(state->device.device, retired->render_pass, NULL);
+        }
+
+        free(retired->framebuffers);
+        free(retired->image_views);
+        free(retired->images);
+    }
+
+    state->retired_swapchain_count = kept;
+}
+
+void recreate_swapchain(application_state* state)
+{
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(state->window, &width, &height);
+
+    while ((width == 0 || height == 0) && !glfwWindowShouldClose(state->window)) {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(state->window, &width, &height);
+    }
+
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    // present ids belong to the swapchain they were queued on. once cleared, the waiter no longer touches the old one
+    if (state->latency.running) {
+        lock_swapchain(state);
+        state->latency.dropped += state->latency.pending_count;
+        state->latency.pending_count = 0;
+        unlock_swapchain(state);
+    }
+
+    if (state->retired_swapchain_count == MAX_RETIRED_SWAPCHAINS) {
+        vkDeviceWaitIdle(state->device.device);
+        release_retired_swapchains(state, true);
+    }
+
+    // the old swapchain, its views and framebuffers live on until the frames using them have finished
+    retired_swapchain* retired = &state->retired_swapchains[state->retired_swapchain_count++];
+    retired->swapchain = state->swapchain.swapchain;
+    retired->image_count = state->swapchain.image_count;
+    retired->images = state->swapchain.images;
+    retired->image_views = state->swapchain.image_views;
+    retired->framebuffers = state->framebuffers;
+    retired->render_pass = VK_NULL_HANDLE;
+    retired->pipeline = (pipeline_state){ VK_NULL_HANDLE, VK_NULL_HANDLE };
+    retired->last_value = state->timeline_value;
+
+    state->swapchain.images = NULL;
+    state->swapchain.image_views = NULL;
+    state->framebuffers = NULL;
+
+    VkFormat format = state->surface.format;
+
+    create_swapchain(state);
+
+    // viewport and scissor are dynamic, the render pass and pipeline only depend on the format.
+    // with dynamic rendering there is no render pass and no framebuffers, a resize only rebuilds the views
+    if (state->surface.format != format) {
+        // a reload in flight builds against the old render pass and layout, so it has to land first
+        finish_shader_reload(state);
+
+        retired->render_pass = state->render_pass;
+        retired->pipeline = state->graphics_pipeline;
+
+        create_render_pass(state);
+        create_graphics_pipeline(state);
+    }
+
+    create_framebuffers(state);
+}
+
+void release_retired_pipelines(application_state* state, bool all)
+{
+    u32 kept = 0;
+
+    for (u32 i = 0; i < state->retired_pipeline_count; ++i) {
+        retired_pipeline* retired = &state->retired_pipelines[i];
+
+        if (!all && !timeline_reached(state, retired->last_value)) {
+            state->retired_pipelines[kept++] = *retired;
+            continue;
+        }
+
+        vkDestroyPipeline(state->device.device, retired->pipeline, NULL);
+    }
+
+    state->retired_pipeline_count = kept;
+}
+
+void retire_pipeline(application_state* state, VkPipeline pipeline)
+{
+    if (pipeline == VK_NULL_HANDLE) {
+        return;
+    }
+
+    release_retired_pipelines(state, false);
+
+    if (state->retired_pipeline_count == MAX_RETIRED_PIPELINES) {
+        wait_timeline(state, state->retired_pipelines[0].last_value);
+        release_retired_pipelines(state, false);
+    }
+
+    retired_pipeline* retired = &state->retired_pipelines[state->retired_pipeline_count++];
+    retired->pipeline = pipeline;
+    retired->last_value = state->timeline_value;
+}
+
+// compiles the changed sources into the spir-v the app loads, then builds the affected pipelines through the
+// pipeline cache. only the pipelines are rebuilt, the layouts stay so bound descriptor sets remain valid
+int shader_reload_thread(void* context)
+{
+    application_state* state = (application_state*)context;
+    shader_reload* reload = &state->reload;
+
+    for (u32 i = 0; i < reload->source_count; ++i) {
+        const char* name = reload->sources[i];
+
+        char command[1024];
+        snprintf(command, sizeof(command), "\"%s\" -V \"%s/%s\" -o \"shaders/%s.spv\"", SHADER_COMPILER, SHADER_SOURCE_DIR, name, name);
+
+        if (system(command) != 0) {
+            fprintf(stderr, "failed to compile shader %s\n", name);
+            atomic_store_explicit(&reload->done, true, memory_order_release);
+            return 1;
+        }
+    }
+
+    if (reload->graphics) {
+        reload->graphics_pipeline = build_graphics_pipeline(state, reload->format, reload->render_pass);
+    }
+
+    if (reload->compute) {
+        reload->cull_pipeline = build_cull_pipeline(state);
+    }
+
+    atomic_store_explicit(&reload->done, true, memory_order_release);
+
+    return 0;
+}
+
+// joins the worker and swaps its pipelines in, the old ones are retired on the timeline
+void apply_shader_reload(application_state* state)
+{
+    shader_reload* reload = &state->reload;
+
+    thrd_join(reload->thread, NULL);
+    reload->running = false;
+
+    bool reloaded = false;
+
+    if (reload->graphics_pipeline != VK_NULL_HANDLE) {
+        if (reload->format == state->surface.format && reload->render_pass == state->render_pass) {
+            retire_pipeline(state, state->graphics_pipeline.pipeline);
+            state->graphics_pipeline.pipeline = reload->graphics_pipeline;
+            reloaded = true;
+        } else {
+            vkDestroyPipeline(state->device.device, reload->graphics_pipeline, NULL);
+        }
+    }
+
+    if (reload->cull_pipeline != VK_NULL_HANDLE) {
+        retire_pipeline(state, state->cull_pipeline.pipeline);
+        state->cull_pipeline.pipeline = reload->cull_pipeline;
+        reloaded = true;
+    }
+
+    reload->graphics_pipeline = VK_NULL_HANDLE;
+    reload->cull_pipeline = VK_NULL_HANDLE;
+
+    if (reloaded) {
+        printf("reloaded shaders\n");
+    }
+}
+
+// called at the start of a frame, before anything is recorded. never waits on the worker
+void update_shader_reload(application_state* state)
+{
+    if (!state->hot_reload) {
+        return;
+    }
+
+    shader_reload* reload = &state->reload;
+
+    if (reload->running) {
+        if (!atomic_load_explicit(&reload->done, memory_order_acquire)) {
+            return;
+        }
+
+        apply_shader_reload(state);
+    }
+
+    reload->source_count = shader_watch_poll(&reload->watch, reload->sources);
+    if (reload->source_count == 0) {
+        return;
+    }
+
+    reload->graphics = false;
+    reload->compute = false;
+
+    for (u32 i = 0; i < reload->source_count; ++i) {
+        const char* extension = strrchr(reload->sources[i], '.');
+
+        // shader_watch_poll only reports .vert, .frag and .comp names, the check is for safety
+        if (extension != NULL && strcmp(extension, ".comp") == 0) {
+            reload->compute = state->gpu_culling;
+        } else {
+            reload->graphics = true;
+        }
+    }
+
+    reload->format = state->surface.format;
+    reload->render_pass = state->render_pass;
+    atomic_store_explicit(&reload->done, false, memory_order_relaxed);
+
+    if (thrd_create(&reload->thread, shader_reload_thread, state) != thrd_success) {
+        fprintf(stderr, "failed to start shader reload thread\n");
+        return;
+    }
+
+    reload->running = true;
+}
+
+// waits for a running reload and applies it
+void finish_shader_reload(application_state* state)
+{
+    if (state->reload.running) {
+        apply_shader_reload(state);
+    }
+}
+
+void create_shader_reload(application_state* state)
+{
+    if (!state->hot_reload) {
+        return;
+    }
+
+    if (!shader_watch_open(&state->reload.watch, SHADER_SOURCE_DIR)) {
+        fprintf(stderr, "failed to watch %s, shader hot reload is disabled\n", SHADER_SOURCE_DIR);
+        state->hot_reload = false;
+        return;
+    }
+
+    printf("watching %s for shader changes\n", SHADER_SOURCE_DIR);
+}
+
+void destroy_shader_reload(application_state* state)
+{
+    if (!state->hot_reload) {
+        return;
+    }
+
+    finish_shader_reload(state);
+    shader_watch_close(&state->reload.watch);
+    release_retired_pipelines(state, true);
+}
+
+void create_buffer(application_state* state, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, memory_allocation* buffer_allocation)
+{
+    VkBufferCreateInfo create_info;
+    create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    create_info.pNext = NULL;
+    create_info.flags = 0;
+    create_info.size = size;
+    create_info.usage = usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.queueFamilyIndexCount = 0;
+    create_info.pQueueFamilyIndices = NULL;
+
+    if (vkCreateBuffer(state->device.device, &create_info, NULL, buffer) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create buffer\n");
+        return;
+    }
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(state->device.device, *buffer, &memory_requirements);
+
+    if (!memory_allocator_alloc(&state->allocator, &memory_requirements, properties, MEMORY_RESOURCE_LINEAR, buffer_allocation)) {
+        fprintf(stderr, "failed to allocate buffer memory\n");
+        return;
+    }
+
+    vkBindBufferMemory(state->device.device, *buffer, buffer_allocation->memory, buffer_allocation->offset);
+}
+
+void create_staging_ring(application_state* state)
+{
+    staging_ring* ring = &state->staging;
+
+    ring->size = STAGING_RING_SIZE;
+    create_buffer(state, ring->size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &ring->buffer.buffer, &ring->buffer.allocation);
+    ring->mapped = (u8*)ring->buffer.allocation.mapped;
+}
+
+void release_staging_temporaries(application_state* state, buffer* temporaries, u32 count)
+{
+    for (u32 i = 0; i < count; ++i) {
+        vkDestroyBuffer(state->device.device, temporaries[i].buffer, NULL);
+        memory_allocator_free(&state->allocator, &temporaries[i].allocation);
+    }
+
+    free(temporaries);
+}
+
+// retires finished submissions from the oldest one on, waiting for at most one of them when wait is set
+void retire_staging_submissions(application_state* state, bool wait)
+{
+    staging_ring* ring = &state->staging;
+
+    while (ring->submission_count > 0) {
+        staging_submission* submission = &ring->submissions[ring->first_submission];
+
+        if (wait) {
+            wait_timeline(state, submission->value);
+            wait = false;
+        } else if (!timeline_reached(state, submission->value)) {
+            break;
+        }
+
+        ring->tail = submission->end;
+
+        release_staging_temporaries(state, submission->temporaries, submission->temporary_count);
+        submission->temporaries = NULL;
+        submission->temporary_count = 0;
+
+        ring->first_submission = (ring->first_submission + 1) % STAGING_MAX_SUBMISSIONS;
+        ring->submission_count -= 1;
+    }
+}
+
+void destroy_staging_ring(application_state* state)
+{
+    staging_ring* ring = &state->staging;
+
+    while (ring->submission_count > 0) {
+        retire_staging_submissions(state, true);
+    }
+
+    release_staging_temporaries(state, ring->temporaries, ring->temporary_count);
+
+    vkDestroyBuffer(state->device.device, ring->buffer.buffer, NULL);
+    memory_allocator_free(&state->allocator, &ring->buffer.allocation);
+}
+
+bool staging_ring_fits(staging_ring* ring, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+    VkDeviceSize aligned = (ring->head + alignment - 1) / alignment * alignment;
+
+    // head never catches up with tail from behind, so head == tail always means empty
+    if (ring->head >= ring->tail) {
+        if (aligned + size <= ring->size) {
+            *offset = aligned;
+            return true;
+        }
+
+        if (size < ring->tail) {
+            *offset = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (aligned + size < ring->tail) {
+        *offset = aligned;
+        return true;
+    }
+
+    return false;
+}
+
+// space stays reserved until the timeline reaches the value of the next submit_staging
+staging_region stage_upload(application_state* state, VkDeviceSize size, VkDeviceSize alignment)
+{
+    staging_ring* ring = &state->staging;
+    staging_region region;
+
+    retire_staging_submissions(state, false);
+
+    if (ring->submission_count == 0 && ring->head == ring->tail) {
+        ring->head = 0;
+        ring->tail = 0;
+    }
+
+    VkDeviceSize offset = 0;
+    bool fits = size <= ring->size && staging_ring_fits(ring, size, alignment, &offset);
+
+    while (!fits && size <= ring->size) {
+        if (ring->submission_count > 0) {
+            retire_staging_submissions(state, true);
+        } else if (state->uploads.recording) {
+            flush_uploads(state);
+        } else {
+            break;
+        }
+
+        fits = staging_ring_fits(ring, size, alignment, &offset);
+    }
+
+    if (fits) {
+        ring->head = offset + size;
+
+        region.buffer = ring->buffer.buffer;
+        region.offset = offset;
+        region.mapped = ring->mapped + offset;
+
+        return region;
+    }
+
+    // larger than the ring
+    ring->temporaries = (buffer*)realloc(ring->temporaries, sizeof(buffer) * (ring->temporary_count + 1));
+    buffer* temporary = &ring->temporaries[ring->temporary_count++];
+
+    create_buffer(state, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &temporary->buffer, &temporary->allocation);
+
+    region.buffer = temporary->buffer;
+    region.offset = 0;
+    region.mapped = temporary->allocation.mapped;
+
+    return region;
 }
 
-void recreate_swapchain(application_state* state)
+// closes the current batch of staged uploads, the returned timeline value must be signaled by the submit that consumes them
+u64 submit_staging(application_state* state)
 {
-    vkDeviceWaitIdle(state->device.device);
+    staging_ring* ring = &state->staging;
 
-    destroy_graphics_pipeline(state);
-    destroy_framebuffers(state);
-    destroy_render_pass(state);
-    destroy_swapchain(state);
+    if (ring->submission_count == STAGING_MAX_SUBMISSIONS) {
+        retire_staging_submissions(state, true);
+    }
 
-    create_swapchain(state);
-    create_render_pass(state);
-    create_graphics_pipeline(state);
-    create_framebuffers(state);
+    u32 index = (ring->first_submission + ring->submission_count) % STAGING_MAX_SUBMISSIONS;
+    staging_submission* submission = &ring->submissions[index];
+
+    submission->value = next_timeline_value(state);
+    submission->end = ring->head;
+    submission->temporaries = ring->temporaries;
+    submission->temporary_count = ring->temporary_count;
+
+    ring->temporaries = NULL;
+    ring->temporary_count = 0;
+    ring->submission_count += 1;
+
+    return submission->value;
 }
 
-unsigned int find_memory_type(application_state* state, unsigned int type_filter, VkMemoryPropertyFlags properties)
+void create_upload_context(application_state* state)
 {
-    VkPhysicalDeviceMemoryProperties memory_properties;
-    vkGetPhysicalDeviceMemoryProperties(state->device.physical_device, &memory_properties);
+    upload_context* uploads = &state->uploads;
+
+    uploads->dedicated_transfer = state->device.transfer_queue.index != state->device.graphics_queue.index;
+
+    VkCommandPoolCreateInfo pool_info;
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.pNext = NULL;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = state->device.transfer_queue.index;
+
+    if (vkCreateCommandPool(state->device.device, &pool_info, NULL, &uploads->transfer_pool) != VK_SUCCESS) {
+        fprintf(stderr, "failed to create upload command pool\n");
+    }
+
+    if (uploads->dedicated_transfer) {
+        pool_info.queueFamilyIndex = state->device.graphics_queue.index;
 
-    for (unsigned int i = 0; i < memory_properties.memoryTypeCount; ++i) {
-        if (type_filter & (1 << i) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
+        if (vkCreateCommandPool(state->device.device, &pool_info, NULL, &uploads->graphics_pool) != VK_SUCCESS) {
+            fprintf(stderr, "failed to create upload acquire command pool\n");
         }
     }
 
-    fprintf(stderr, "failed to find suitable memory type\n");
+    VkSemaphoreCreateInfo semaphore_info;
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = NULL;
+    semaphore_info.flags = 0;
 
-    return -1;
+    for (u32 i = 0; i < UPLOAD_MAX_BATCHES; ++i) {
+        vkCreateSemaphore(state->device.device, &semaphore_info, NULL, &uploads->batches[i].semaphore);
+    }
 }
 
-void create_buffer(application_state* state, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer* buffer, VkDeviceMemory* buffer_memory)
+// frees the command buffers of finished batches, waiting for at most one of them when wait is set
+void retire_uploads(application_state* state, bool wait)
 {
-    VkBufferCreateInfo create_info;
-    create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    create_info.pNext = NULL;
-    create_info.flags = 0;
-    create_info.size = size;
-    create_info.usage = usage;
-    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    create_info.queueFamilyIndexCount = 0;
-    create_info.pQueueFamilyIndices = NULL;
+    upload_context* uploads = &state->uploads;
 
-    if (vkCreateBuffer(state->device.device, &create_info, NULL, buffer) != VK_SUCCESS) {
-        fprintf(stderr, "failed to create buffer\n");
-        return;
+    while (uploads->batch_count > 0) {
+        upload_batch* batch = &uploads->batches[uploads->first_batch];
+
+        if (wait) {
+            wait_timeline(state, batch->value);
+            wait = false;
+        } else if (!timeline_reached(state, batch->value)) {
+            break;
+        }
+
+        vkFreeCommandBuffers(state->device.device, uploads->transfer_pool, 1, &batch->transfer_commands);
+        if (batch->graphics_commands != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(state->device.device, uploads->graphics_pool, 1, &batch->graphics_commands);
+        }
+
+        batch->value = 0;
+        batch->transfer_commands = VK_NULL_HANDLE;
+        batch->graphics_commands = VK_NULL_HANDLE;
+
+        uploads->first_batch = (uploads->first_batch + 1) % UPLOAD_MAX_BATCHES;
+        uploads->batch_count -= 1;
     }
+}
 
-    VkMemoryRequirements memory_requirements;
-    vkGetBufferMemoryRequirements(state->device.device, *buffer, &memory_requirements);
+void destroy_upload_context(application_state* state)
+{
+    upload_context* uploads = &state->uploads;
 
-    VkMemoryAllocateInfo allocate_info;
-    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocate_info.pNext = NULL;
-    allocate_info.allocationSize = memory_requirements.size;
-    allocate_info.memoryTypeIndex = find_memory_type(state, memory_requirements.memoryTypeBits, properties);
+    flush_uploads(state);
 
-    if (vkAllocateMemory(state->device.device, &allocate_info, NULL, buffer_memory) != VK_SUCCESS) {
-        fprintf(stderr, "failed to allocate buffer memory\n");
-        return;
+    while (uploads->batch_count > 0) {
+        retire_uploads(state, true);
+    }
+
+    for (u32 i = 0; i < UPLOAD_MAX_BATCHES; ++i) {
+        vkDestroySemaphore(state->device.device, uploads->batches[i].semaphore, NULL);
+    }
+
+    if (uploads->dedicated_transfer) {
+        vkDestroyCommandPool(state->device.device, uploads->graphics_pool, NULL);
     }
 
-    vkBindBufferMemory(state->device.device, *buffer, *buffer_memory, 0);
+    vkDestroyCommandPool(state->device.device, uploads->transfer_pool, NULL);
 }
 
-VkCommandBuffer begin_single_time_command(application_state* state)
+VkCommandBuffer allocate_upload_command_buffer(application_state* state, VkCommandPool pool)
 {
     VkCommandBufferAllocateInfo allocate_info;
     allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocate_info.pNext = NULL;
-    allocate_info.commandPool = state->command_pool;
+    allocate_info.commandPool = pool;
     allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocate_info.commandBufferCount = 1;
 
@@ -1185,9 +3439,47 @@ VkCommandBuffer begin_single_time_command(application_state* state)
     return command_buffer;
 }
 
-void end_single_time_command(application_state* state, VkCommandBuffer command_buffer)
+void begin_uploads(application_state* state)
+{
+    upload_context* uploads = &state->uploads;
+
+    if (uploads->recording) {
+        return;
+    }
+
+    uploads->transfer_commands = allocate_upload_command_buffer(state, uploads->transfer_pool);
+    uploads->graphics_commands = uploads->dedicated_transfer ? allocate_upload_command_buffer(state, uploads->graphics_pool) : VK_NULL_HANDLE;
+    uploads->recording = true;
+}
+
+// commands recorded here run on the transfer queue
+VkCommandBuffer upload_command_buffer(application_state* state)
 {
-    vkEndCommandBuffer(command_buffer);
+    begin_uploads(state);
+    return state->uploads.transfer_commands;
+}
+
+// submits every upload recorded since the last flush, the timeline reaches the returned value once they are visible to the graphics queue
+u64 flush_uploads(application_state* state)
+{
+    upload_context* uploads = &state->uploads;
+
+    if (!uploads->recording) {
+        return 0;
+    }
+
+    retire_uploads(state, false);
+    if (uploads->batch_count == UPLOAD_MAX_BATCHES) {
+        retire_uploads(state, true);
+    }
+
+    upload_batch* batch = &uploads->batches[(uploads->first_batch + uploads->batch_count) % UPLOAD_MAX_BATCHES];
+
+    batch->value = submit_staging(state);
+    batch->transfer_commands = uploads->transfer_commands;
+    batch->graphics_commands = uploads->graphics_commands;
+
+    vkEndCommandBuffer(batch->transfer_commands);
 
     VkSubmitInfo submit_info;
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1196,31 +3488,111 @@ void end_single_time_command(application_state* state, VkCommandBuffer command_b
     submit_info.pWaitSemaphores = NULL;
     submit_info.pWaitDstStageMask = NULL;
     submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.pCommandBuffers = &batch->transfer_commands;
     submit_info.signalSemaphoreCount = 0;
     submit_info.pSignalSemaphores = NULL;
 
-    vkQueueSubmit(state->device.graphics_queue.queue, 1, &submit_info, VK_NULL_HANDLE);
-    vkQueueWaitIdle(state->device.graphics_queue.queue);
+    VkTimelineSemaphoreSubmitInfo timeline_info;
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.pNext = NULL;
+    timeline_info.waitSemaphoreValueCount = 0;
+    timeline_info.pWaitSemaphoreValues = NULL;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &batch->value;
+
+    // without a dedicated transfer family the transfer queue is the graphics queue, so the
+    // timeline is always signaled from one queue in increasing order
+    if (!uploads->dedicated_transfer) {
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &state->timeline;
+
+        if (vkQueueSubmit(state->device.transfer_queue.queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            fprintf(stderr, "failed to submit uploads\n");
+        }
+    } else {
+        vkEndCommandBuffer(batch->graphics_commands);
+
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &batch->semaphore;
+
+        if (vkQueueSubmit(state->device.transfer_queue.queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            fprintf(stderr, "failed to submit uploads\n");
+        }
+
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkSubmitInfo acquire_info;
+        acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquire_info.pNext = &timeline_info;
+        acquire_info.waitSemaphoreCount = 1;
+        acquire_info.pWaitSemaphores = &batch->semaphore;
+        acquire_info.pWaitDstStageMask = &wait_stage;
+        acquire_info.commandBufferCount = 1;
+        acquire_info.pCommandBuffers = &batch->graphics_commands;
+        acquire_info.signalSemaphoreCount = 1;
+        acquire_info.pSignalSemaphores = &state->timeline;
+
+        if (vkQueueSubmit(state->device.graphics_queue.queue, 1, &acquire_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            fprintf(stderr, "failed to submit upload ownership acquire\n");
+        }
+    }
+
+    uploads->transfer_commands = VK_NULL_HANDLE;
+    uploads->graphics_commands = VK_NULL_HANDLE;
+    uploads->recording = false;
+    uploads->batch_count += 1;
+
+    return batch->value;
+}
+
+// hands an uploaded buffer over to the graphics queue for the given access
+void release_buffer(application_state* state, VkBuffer buffer, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+{
+    upload_context* uploads = &state->uploads;
+    VkCommandBuffer command_buffer = upload_command_buffer(state);
+
+    VkBufferMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.pNext = NULL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dst_access;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    if (!uploads->dedicated_transfer) {
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0, 0, NULL, 1, &barrier, 0, NULL);
+        return;
+    }
+
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = state->device.transfer_queue.index;
+    barrier.dstQueueFamilyIndex = state->device.graphics_queue.index;
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dst_access;
 
-    vkFreeCommandBuffers(state->device.device, state->command_pool, 1, &command_buffer);
+    vkCmdPipelineBarrier(uploads->graphics_commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stage, 0, 0, NULL, 1, &barrier, 0, NULL);
 }
 
-void copy_buffer(application_state* state, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size)
+void copy_buffer(application_state* state, VkBuffer src_buffer, VkDeviceSize src_offset, VkBuffer dst_buffer, VkDeviceSize size)
 {
-    VkCommandBuffer command_buffer = begin_single_time_command(state);
+    VkCommandBuffer command_buffer = upload_command_buffer(state);
 
     VkBufferCopy copy_region;
-    copy_region.srcOffset = 0;
+    copy_region.srcOffset = src_offset;
     copy_region.dstOffset = 0;
     copy_region.size = size;
 
     vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
-
-    end_single_time_command(state, command_buffer);
 }
 
-void create_image(application_state* state, u32 width, u32 height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* img, VkDeviceMemory* img_memory)
+void create_image(application_state* state, u32 width, u32 height, u32 mip_levels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* img, memory_allocation* img_allocation)
 {
     VkImageCreateInfo create_info;
     create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1231,7 +3603,7 @@ void create_image(application_state* state, u32 width, u32 height, VkFormat form
     create_info.extent.width = width;
     create_info.extent.height = height;
     create_info.extent.depth = 1;
-    create_info.mipLevels = 1;
+    create_info.mipLevels = mip_levels;
     create_info.arrayLayers = 1;
     create_info.samples = VK_SAMPLE_COUNT_1_BIT;
     create_info.tiling = tiling;
@@ -1248,22 +3620,19 @@ void create_image(application_state* state, u32 width, u32 height, VkFormat form
     VkMemoryRequirements memory_requirements;
     vkGetImageMemoryRequirements(state->device.device, *img, &memory_requirements);
 
-    VkMemoryAllocateInfo allocate_info;
-    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocate_info.pNext = NULL;
-    allocate_info.allocationSize = memory_requirements.size;
-    allocate_info.memoryTypeIndex = find_memory_type(state, memory_requirements.memoryTypeBits, properties);
+    memory_resource_kind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? MEMORY_RESOURCE_OPTIMAL : MEMORY_RESOURCE_LINEAR;
 
-    if (vkAllocateMemory(state->device.device, &allocate_info, NULL, img_memory) != VK_SUCCESS) {
+    if (!memory_allocator_alloc(&state->allocator, &memory_requirements, properties, kind, img_allocation)) {
         fprintf(stderr, "failed to allocate image memory\n");
+        return;
     }
 
-    vkBindImageMemory(state->device.device, *img, *img_memory, 0);
+    vkBindImageMemory(state->device.device, *img, img_allocation->memory, img_allocation->offset);
 }
 
-void transition_image_layout(application_state* state, VkImage img, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
+void transition_image_layout(application_state* state, VkImage img, VkFormat format, u32 mip_levels, VkImageLayout old_layout, VkImageLayout new_layout)
 {
-    VkCommandBuffer command_buffer = begin_single_time_command(state);
+    VkCommandBuffer command_buffer = upload_command_buffer(state);
 
     VkImageMemoryBarrier barrier;
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1277,7 +3646,7 @@ void transition_image_layout(application_state* state, VkImage img, VkFormat for
     barrier.image = img;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mip_levels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
@@ -1288,80 +3657,469 @@ void transition_image_layout(application_state* state, VkImage img, VkFormat for
         barrier.srcAccessMask = 0;
         barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-        source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else {
+        fprintf(stderr, "unsupported layout transition\n");
+        return;
+    }
+
+    if (!state->uploads.dedicated_transfer || new_layout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        vkCmdPipelineBarrier(command_buffer, source_stage, destination_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+        return;
+    }
+
+    // release on the transfer queue, the matching acquire (same layouts) runs on the graphics queue
+    VkAccessFlags destination_access = barrier.dstAccessMask;
+
+    barrier.dstAccessMask = 0;
+    barrier.srcQueueFamilyIndex = state->device.transfer_queue.index;
+    barrier.dstQueueFamilyIndex = state->device.graphics_queue.index;
+
+    vkCmdPipelineBarrier(command_buffer, source_stage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = destination_access;
+
+    vkCmdPipelineBarrier(state->uploads.graphics_commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, destination_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+void copy_buffer_to_image(application_state* state, VkBuffer buffer, VkDeviceSize buffer_offset, VkImage img, u32 mip_level, u32 width, u32 height)
+{
+    VkCommandBuffer command_buffer = upload_command_buffer(state);
+
+    VkBufferImageCopy region;
+    region.bufferOffset = buffer_offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mip_level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = (VkOffset3D){ 0, 0, 0 };
+    region.imageExtent = (VkExtent3D){ width, height, 1 };
+
+    vkCmdCopyBufferToImage(command_buffer, buffer, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+}
+
+bool format_supports_linear_blit(application_state* state, VkFormat format)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(state->device.physical_device, format, &props);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    return (props.optimalTilingFeatures & required) == required;
+}
+
+// expects every level in TRANSFER_DST_OPTIMAL with level 0 filled, leaves every level in SHADER_READ_ONLY_OPTIMAL
+void generate_mipmaps(application_state* state, VkImage img, u32 width, u32 height, u32 mip_levels)
+{
+    upload_context* uploads = &state->uploads;
+    VkCommandBuffer command_buffer = upload_command_buffer(state);
+
+    VkImageMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = NULL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = img;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    // blits need a graphics queue, so a dedicated transfer queue hands the whole image over first
+    if (uploads->dedicated_transfer) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = state->device.transfer_queue.index;
+        barrier.dstQueueFamilyIndex = state->device.graphics_queue.index;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mip_levels;
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        command_buffer = uploads->graphics_commands;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+
+    barrier.subresourceRange.levelCount = 1;
+
+    i32 mip_width = (i32)width;
+    i32 mip_height = (i32)height;
+
+    for (u32 i = 1; i < mip_levels; ++i) {
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+        i32 next_width = mip_width > 1 ? mip_width / 2 : 1;
+        i32 next_height = mip_height > 1 ? mip_height / 2 : 1;
+
+        VkImageBlit blit;
+        blit.srcOffsets[0] = (VkOffset3D){ 0, 0, 0 };
+        blit.srcOffsets[1] = (VkOffset3D){ mip_width, mip_height, 1 };
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[0] = (VkOffset3D){ 0, 0, 0 };
+        blit.dstOffsets[1] = (VkOffset3D){ next_width, next_height, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+
+        vkCmdBlitImage(command_buffer, img, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+        mip_width = next_width;
+        mip_height = next_height;
+    }
+
+    // the last level was only ever written
+    barrier.subresourceRange.baseMipLevel = mip_levels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+bool format_supports_sampling(application_state* state, VkFormat format)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(state->device.physical_device, format, &props);
+
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+static const texture_asset texture_assets[] = {
+    { "../textures/texture.jpg", { "../textures/texture.bc7.ktx2", "../textures/texture.bc3.ktx2", "../textures/texture.bc1.ktx2" } }
+};
+
+#define TEXTURE_ASSET_COUNT (sizeof(texture_assets) / sizeof(texture_assets[0]))
+
+// runs on a decode thread, only queries the physical device
+bool decode_texture(void* item, void* context)
+{
+    texture_source* source = (texture_source*)item;
+    application_state* state = (application_state*)context;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(state->device.physical_device, &properties);
+
+    // a ktx2 variant the device can sample needs no decode, only a file mapping
+    for (u32 i = 0; i < TEXTURE_KTX2_VARIANTS && state->device.texture_compression_bc; ++i) {
+        if (!source->asset->ktx2_paths[i] || !ktx2_open(&source->ktx2, source->asset->ktx2_paths[i], properties.limits.maxImageDimension2D)) {
+            continue;
+        }
+
+        if (format_supports_sampling(state, source->ktx2.format)) {
+            source->compressed = true;
+            source->width = source->ktx2.width;
+            source->height = source->ktx2.height;
+            source->mip_levels = source->ktx2.level_count;
+            return true;
+        }
+
+        ktx2_close(&source->ktx2);
+    }
+
+    int tex_width;
+    int tex_height;
+    int tex_channels;
+
+    source->pixels = stbi_load(source->asset->image_path, &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
+
+    if (!source->pixels) {
+        fprintf(stderr, "failed to load image %s\n", source->asset->image_path);
+        return false;
+    }
+
+    source->width = (u32)tex_width;
+    source->height = (u32)tex_height;
+    source->mip_levels = mipmap_level_count(source->width, source->height);
+
+    // without linear blits the whole chain is built here instead of on the gpu
+    if (!format_supports_linear_blit(state, VK_FORMAT_R8G8B8A8_SRGB)) {
+        source->mip_chain = (u8*)malloc(mipmap_chain_size_rgba8(source->width, source->height, source->mip_levels));
+        memcpy(source->mip_chain, source->pixels, (size_t)source->width * source->height * 4);
+        mipmap_generate_rgba8(source->mip_chain, source->width, source->height, source->mip_levels, true);
+
+        stbi_image_free(source->pixels);
+        source->pixels = NULL;
+    }
+
+    return true;
+}
+
+void release_texture_source(texture_source* source)
+{
+    if (source->compressed) {
+        ktx2_close(&source->ktx2);
+    }
+
+    stbi_image_free(source->pixels);
+    free(source->mip_chain);
+
+    source->compressed = false;
+    source->pixels = NULL;
+    source->mip_chain = NULL;
+}
+
+static const char* mesh_assets[] = {
+    "../models/model.obj"
+};
+
+#define MESH_ASSET_COUNT (sizeof(mesh_assets) / sizeof(mesh_assets[0]))
+
+// stands in for a missing or unreadable model
+static const mesh_vertex fallback_quad[] = {
+    {{-1.0f, -1.0f, 0.0f}, {0.8f, 0.2f, 0.2f}, {1.0f, 0.0f}},
+    {{ 1.0f, -1.0f, 0.0f}, {0.2f, 0.8f, 0.2f}, {0.0f, 0.0f}},
+    {{ 1.0f,  1.0f, 0.0f}, {0.2f, 0.2f, 0.8f}, {0.0f, 1.0f}},
+    {{ 1.0f,  1.0f, 0.0f}, {0.2f, 0.2f, 0.8f}, {0.0f, 1.0f}},
+    {{-1.0f,  1.0f, 0.0f}, {0.8f, 0.8f, 0.8f}, {1.0f, 1.0f}},
+    {{-1.0f, -1.0f, 0.0f}, {0.8f, 0.2f, 0.2f}, {1.0f, 0.0f}}
+};
+
+void optimize_mesh(mesh* mesh, const char* path)
+{
+    f32 acmr = mesh_acmr(mesh);
+
+    mesh_optimize_vertex_cache(mesh);
+    mesh_optimize_vertex_fetch(mesh);
+
+    printf("mesh %s: %u vertices, %u triangles, acmr %.3f -> %.3f\n", path, mesh->vertex_count, mesh->index_count / 3, acmr, mesh_acmr(mesh));
+}
+
+void build_fallback_mesh(mesh_cache* cache)
+{
+    mesh mesh;
+    mesh_build_indexed(&mesh, fallback_quad, sizeof(fallback_quad) / sizeof(fallback_quad[0]));
+    optimize_mesh(&mesh, "fallback quad");
+
+    mesh_cache_build(cache, &mesh, 0, 0, 0);
+    mesh_destroy(&mesh);
+}
+
+// runs on a decode thread, the parsed and optimized streams are cached next to the source as <path>.cache
+bool decode_mesh(void* item, void* context)
+{
+    mesh_source* source = (mesh_source*)item;
+    (void)context;
+
+    mesh mesh;
+    i64 source_mtime;
+    u64 source_size;
+
+    if (!file_map_stat(source->path, &source_mtime, &source_size)) {
+        build_fallback_mesh(&source->cache);
+        return true;
+    }
+
+    // hashing the mapped source is far cheaper than parsing it
+    u64 source_hash = 0;
+    file_mapping source_file;
+    if (file_map_open(&source_file, source->path)) {
+        source_hash = mesh_cache_hash(source_file.data, source_file.size);
+        file_map_close(&source_file);
+    }
+
+    char cache_path[1024];
+    snprintf(cache_path, sizeof(cache_path), "%s.cache", source->path);
+
+    if (mesh_cache_open(&source->cache, cache_path, source_hash, source_mtime, source_size)) {
+        return true;
+    }
+
+    if (!mesh_load_obj(&mesh, source->path)) {
+        fprintf(stderr, "failed to load mesh %s\n", source->path);
+        mesh_destroy(&mesh);
+        build_fallback_mesh(&source->cache);
+        return true;
+    }
+
+    optimize_mesh(&mesh, source->path);
+
+    mesh_cache_build(&source->cache, &mesh, source_hash, source_mtime, source_size);
+    mesh_destroy(&mesh);
+
+    if (!mesh_cache_write(&source->cache, cache_path)) {
+        fprintf(stderr, "failed to write mesh cache %s\n", cache_path);
+    }
+
+    return true;
+}
+
+// starts decoding every asset while the rest of the device objects are created, results are popped textures first, then meshes
+void start_asset_decode(application_state* state)
+{
+    u32 job_count = TEXTURE_ASSET_COUNT + MESH_ASSET_COUNT;
+
+    state->texture_sources = (texture_source*)calloc(TEXTURE_ASSET_COUNT, sizeof(texture_source));
+    state->mesh_sources = (mesh_source*)calloc(MESH_ASSET_COUNT, sizeof(mesh_source));
+    state->decode_jobs = (decode_job*)calloc(job_count, sizeof(decode_job));
+
+    for (u32 i = 0; i < TEXTURE_ASSET_COUNT; ++i) {
+        state->texture_sources[i].asset = &texture_assets[i];
+
+        state->decode_jobs[i].decode = decode_texture;
+        state->decode_jobs[i].item = &state->texture_sources[i];
+        state->decode_jobs[i].context = state;
+    }
+
+    for (u32 i = 0; i < MESH_ASSET_COUNT; ++i) {
+        decode_job* job = &state->decode_jobs[TEXTURE_ASSET_COUNT + i];
+
+        state->mesh_sources[i].path = mesh_assets[i];
+
+        job->decode = decode_mesh;
+        job->item = &state->mesh_sources[i];
+        job->context = state;
+    }
+
+    decode_pool_start(&state->decoder, state->decode_jobs, job_count, decode_pool_default_thread_count());
+}
 
-        source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else {
-        fprintf(stderr, "unsupported layout transition\n");
+void finish_asset_decode(application_state* state)
+{
+    decode_pool_join(&state->decoder);
+
+    for (u32 i = 0; i < TEXTURE_ASSET_COUNT; ++i) {
+        release_texture_source(&state->texture_sources[i]);
     }
 
-    vkCmdPipelineBarrier(command_buffer, source_stage, destination_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+    for (u32 i = 0; i < MESH_ASSET_COUNT; ++i) {
+        mesh_cache_release(&state->mesh_sources[i].cache);
+    }
 
-    end_single_time_command(state, command_buffer);
+    free(state->decode_jobs);
+    free(state->mesh_sources);
+    free(state->texture_sources);
+    state->decode_jobs = NULL;
+    state->mesh_sources = NULL;
+    state->texture_sources = NULL;
 }
 
-void copy_buffer_to_image(application_state* state, VkBuffer buffer, VkImage img, u32 width, u32 height)
+// mip levels are copied from the file mapping into staging as stored
+void upload_texture_ktx2(application_state* state, const ktx2_texture* texture)
 {
-    VkCommandBuffer command_buffer = begin_single_time_command(state);
+    // copy offsets have to be a multiple of the block size
+    VkDeviceSize staging_size = 0;
+    for (u32 i = 0; i < texture->level_count; ++i) {
+        staging_size += (texture->levels[i].size + 15) & ~(VkDeviceSize)15;
+    }
 
-    VkBufferImageCopy region;
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = (VkOffset3D){ 0, 0, 0 };
-    region.imageExtent = (VkExtent3D){ width, height, 1 };
+    staging_region staging = stage_upload(state, staging_size, STAGING_DEFAULT_ALIGNMENT);
 
-    vkCmdCopyBufferToImage(command_buffer, buffer, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    create_image(state, texture->width, texture->height, texture->level_count, texture->format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->texture_image.image, &state->texture_image.allocation);
+
+    transition_image_layout(state, state->texture_image.image, texture->format, texture->level_count, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-    end_single_time_command(state, command_buffer);
+    VkDeviceSize offset = 0;
+    for (u32 i = 0; i < texture->level_count; ++i) {
+        const ktx2_level* level = &texture->levels[i];
+
+        memcpy((u8*)staging.mapped + offset, level->data, level->size);
+        copy_buffer_to_image(state, staging.buffer, staging.offset + offset, state->texture_image.image, i, level->width, level->height);
+
+        offset += (level->size + 15) & ~(VkDeviceSize)15;
+    }
+
+    transition_image_layout(state, state->texture_image.image, texture->format, texture->level_count, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
-void create_texture_image(application_state* state)
+void upload_texture_pixels(application_state* state, const texture_source* source)
 {
-    int tex_width;
-    int tex_height;
-    int tex_channels;
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    u32 width = source->width;
+    u32 height = source->height;
+    u32 mip_levels = source->mip_levels;
+    bool blit = source->mip_chain == NULL;
 
-    stbi_uc* pixels = stbi_load("../textures/texture.jpg", &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
+    VkDeviceSize staging_size = blit ? (VkDeviceSize)width * height * 4 : mipmap_chain_size_rgba8(width, height, mip_levels);
 
-    VkDeviceSize image_size = tex_width * tex_height * 4;
+    staging_region staging = stage_upload(state, staging_size, STAGING_DEFAULT_ALIGNMENT);
+    memcpy(staging.mapped, blit ? source->pixels : source->mip_chain, staging_size);
 
-    if (!pixels) {
-        fprintf(stderr, "failed to load image\n");
+    create_image(state, width, height, mip_levels, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->texture_image.image, &state->texture_image.allocation);
+
+    transition_image_layout(state, state->texture_image.image, format, mip_levels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    if (blit) {
+        copy_buffer_to_image(state, staging.buffer, staging.offset, state->texture_image.image, 0, width, height);
+        generate_mipmaps(state, state->texture_image.image, width, height, mip_levels);
         return;
     }
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    VkDeviceSize offset = staging.offset;
+
+    for (u32 i = 0; i < mip_levels; ++i) {
+        copy_buffer_to_image(state, staging.buffer, offset, state->texture_image.image, i, width, height);
+
+        offset += (VkDeviceSize)width * height * 4;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    transition_image_layout(state, state->texture_image.image, format, mip_levels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+// takes the next decoded texture in asset order
+void create_texture_image(application_state* state)
+{
+    decode_job* job = decode_pool_pop(&state->decoder);
 
-    create_buffer(state, image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+    if (!job || !job->succeeded) {
+        return;
+    }
 
-    void* data;
-    vkMapMemory(state->device.device, staging_buffer_memory, 0, image_size, 0, &data);
-    memcpy(data, pixels, image_size);
-    vkUnmapMemory(state->device.device, staging_buffer_memory);
+    texture_source* source = (texture_source*)job->item;
 
-    stbi_image_free(pixels);
+    if (source->compressed) {
+        upload_texture_ktx2(state, &source->ktx2);
+    } else {
+        upload_texture_pixels(state, source);
+    }
 
-    create_image(state, tex_width, tex_height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->texture_image.image, &state->texture_image.memory);
+    VkFormat format = source->compressed ? source->ktx2.format : VK_FORMAT_R8G8B8A8_SRGB;
 
-    transition_image_layout(state, state->texture_image.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copy_buffer_to_image(state, staging_buffer, state->texture_image.image, tex_width, tex_height);
-    transition_image_layout(state, state->texture_image.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    state->texture_mip_levels = source->mip_levels;
+    state->texture_image_view = create_image_view(state, state->texture_image.image, format, source->mip_levels);
 
-    vkDestroyBuffer(state->device.device, staging_buffer, NULL);
-    vkFreeMemory(state->device.device, staging_buffer_memory, NULL);
+    if (state->bindless) {
+        state->texture_index = register_texture(state, state->texture_image_view);
+    }
 
-    state->texture_image_view = create_image_view(state, state->texture_image.image, VK_FORMAT_R8G8B8A8_SRGB);
+    // staging holds its own copy, so the decoded data can go right away
+    release_texture_source(source);
 }
 
 void destroy_texture_image(application_state* state)
@@ -1369,7 +4127,7 @@ void destroy_texture_image(application_state* state)
     vkDestroyImageView(state->device.device, state->texture_image_view, NULL);
 
     vkDestroyImage(state->device.device, state->texture_image.image, NULL);
-    vkFreeMemory(state->device.device, state->texture_image.memory, NULL);
+    memory_allocator_free(&state->allocator, &state->texture_image.allocation);
 }
 
 void create_texture_sampler(application_state* state)
@@ -1393,13 +4151,17 @@ void create_texture_sampler(application_state* state)
     create_info.compareEnable = VK_FALSE;
     create_info.compareOp = VK_COMPARE_OP_ALWAYS;
     create_info.minLod = 0.0f;
-    create_info.maxLod = 0.0f;
+    create_info.maxLod = (f32)state->texture_mip_levels;
     create_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     create_info.unnormalizedCoordinates = VK_FALSE;
 
     if (vkCreateSampler(state->device.device, &create_info, NULL, &state->texture_sampler) != VK_SUCCESS) {
         fprintf(stderr, "failed to create texture sampler\n");
     }
+
+    if (state->bindless) {
+        state->sampler_index = register_sampler(state, state->texture_sampler);
+    }
 }
 
 void destroy_texture_sampler(application_state* state)
@@ -1407,200 +4169,633 @@ void destroy_texture_sampler(application_state* state)
     vkDestroySampler(state->device.device, state->texture_sampler, NULL);
 }
 
-void create_vertex_buffer(application_state* state)
+void create_vertex_buffer(application_state* state, const mesh_vertex* vertices, u32 vertex_count)
 {
-    const vertex vertices[] = {
-        {{-1.0f, -1.0f}, {0.8f, 0.2f, 0.2f}, {1.0f, 0.0f}},
-        {{ 1.0f, -1.0f}, {0.2f, 0.8f, 0.2f}, {0.0f, 0.0f}},
-        {{ 1.0f,  1.0f}, {0.2f, 0.2f, 0.8f}, {0.0f, 1.0f}},
-        {{-1.0f,  1.0f}, {0.8f, 0.8f, 0.8f}, {1.0f, 1.0f}}
-    };
+    VkDeviceSize buffer_size = sizeof(mesh_vertex) * vertex_count;
+
+    staging_region staging = stage_upload(state, buffer_size, STAGING_DEFAULT_ALIGNMENT);
+    memcpy(staging.mapped, vertices, buffer_size);
+
+    create_buffer(state, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->vertex_buffer.buffer, &state->vertex_buffer.allocation);
 
-    VkDeviceSize buffer_size = sizeof(vertices[0]) * (sizeof(vertices) / sizeof(vertices[0]));
+    copy_buffer(state, staging.buffer, staging.offset, state->vertex_buffer.buffer, buffer_size);
+    release_buffer(state, state->vertex_buffer.buffer, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+void destroy_vertex_buffer(application_state* state)
+{
+    vkDestroyBuffer(state->device.device, state->vertex_buffer.buffer, NULL);
+    memory_allocator_free(&state->allocator, &state->vertex_buffer.allocation);
+}
 
-    create_buffer(state, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+// index_size is 2 or 4 bytes
+void create_index_buffer(application_state* state, const void* indices, u32 index_count, u32 index_size)
+{
+    VkDeviceSize buffer_size = (VkDeviceSize)index_size * index_count;
 
-    void* data;
-    vkMapMemory(state->device.device, staging_buffer_memory, 0, buffer_size, 0, &data);
-    memcpy(data, vertices, buffer_size);
-    vkUnmapMemory(state->device.device, staging_buffer_memory);
+    staging_region staging = stage_upload(state, buffer_size, STAGING_DEFAULT_ALIGNMENT);
+    memcpy(staging.mapped, indices, buffer_size);
 
-    create_buffer(state, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->vertex_buffer.buffer, &state->vertex_buffer.memory);
+    state->index_count = index_count;
+    state->index_type = index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 
-    copy_buffer(state, staging_buffer, state->vertex_buffer.buffer, buffer_size);
+    create_buffer(state, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->index_buffer.buffer, &state->index_buffer.allocation);
 
-    vkDestroyBuffer(state->device.device, staging_buffer, NULL);
-    vkFreeMemory(state->device.device, staging_buffer_memory, NULL);
+    copy_buffer(state, staging.buffer, staging.offset, state->index_buffer.buffer, buffer_size);
+    release_buffer(state, state->index_buffer.buffer, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 }
 
-void destroy_vertex_buffer(application_state* state)
+void destroy_index_buffer(application_state* state)
 {
-    vkDestroyBuffer(state->device.device, state->vertex_buffer.buffer, NULL);
-    vkFreeMemory(state->device.device, state->vertex_buffer.memory, NULL);
+    vkDestroyBuffer(state->device.device, state->index_buffer.buffer, NULL);
+    memory_allocator_free(&state->allocator, &state->index_buffer.allocation);
 }
 
-void create_index_buffer(application_state* state)
+// takes the next decoded mesh in asset order, the draw path always gets buffers
+void create_mesh(application_state* state)
 {
-    const u16 indices[] = { 0, 1, 2, 2, 3, 0 };
+    decode_job* job = decode_pool_pop(&state->decoder);
+
+    mesh_cache fallback;
+    mesh_cache* cache = &fallback;
+
+    if (job && job->succeeded) {
+        cache = &((mesh_source*)job->item)->cache;
+    } else {
+        build_fallback_mesh(&fallback);
+    }
 
-    VkDeviceSize buffer_size = sizeof(indices[0]) * (sizeof(indices) / sizeof(indices[0]));
+    const mesh_cache_header* header = cache->header;
 
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
+    f32 min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    f32 max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
 
-    create_buffer(state, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
+    for (u32 i = 0; i < header->vertex_count; ++i) {
+        for (u32 c = 0; c < 3; ++c) {
+            min[c] = fminf(min[c], cache->vertices[i].position[c]);
+            max[c] = fmaxf(max[c], cache->vertices[i].position[c]);
+        }
+    }
 
-    void* data;
-    vkMapMemory(state->device.device, staging_buffer_memory, 0, buffer_size, 0, &data);
-    memcpy(data, indices, buffer_size);
-    vkUnmapMemory(state->device.device, staging_buffer_memory);
+    // local box every instance's culling bounds are derived from
+    for (u32 c = 0; c < 3 && header->vertex_count > 0; ++c) {
+        state->mesh_center[c] = 0.5f * (min[c] + max[c]);
+        state->mesh_extent[c] = 0.5f * (max[c] - min[c]);
+    }
 
-    create_buffer(state, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->index_buffer.buffer, &state->index_buffer.memory);
+    // straight from the cache mapping into staging
+    create_vertex_buffer(state, cache->vertices, header->vertex_count);
+    create_index_buffer(state, cache->indices, header->index_count, header->index_size);
 
-    copy_buffer(state, staging_buffer, state->index_buffer.buffer, buffer_size);
+    mesh_cache_release(cache);
+}
 
-    vkDestroyBuffer(state->device.device, staging_buffer, NULL);
-    vkFreeMemory(state->device.device, staging_buffer_memory, NULL);
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
 }
 
-void destroy_index_buffer(application_state* state)
+// one object per instance slot, the per frame draw command and count slices are written by cull.comp
+void create_cull_buffers(application_state* state)
 {
-    vkDestroyBuffer(state->device.device, state->index_buffer.buffer, NULL);
-    vkFreeMemory(state->device.device, state->index_buffer.memory, NULL);
+    if (!state->gpu_culling) {
+        return;
+    }
+
+    VkDeviceSize object_size = sizeof(gpu_object) * state->instance_capacity;
+
+    staging_region staging = stage_upload(state, object_size, STAGING_DEFAULT_ALIGNMENT);
+    gpu_object* objects = (gpu_object*)staging.mapped;
+
+    for (u32 i = 0; i < state->instance_capacity; ++i) {
+        memcpy(objects[i].sphere, state->mesh_center, sizeof(state->mesh_center));
+        objects[i].sphere[3] = glm_vec3_norm(state->mesh_extent);
+        objects[i].index_count = state->index_count;
+        objects[i].first_index = 0;
+        objects[i].vertex_offset = 0;
+        objects[i].padding = 0;
+    }
+
+    create_buffer(state, object_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->object_buffer.buffer, &state->object_buffer.allocation);
+
+    copy_buffer(state, staging.buffer, staging.offset, state->object_buffer.buffer, object_size);
+    release_buffer(state, state->object_buffer.buffer, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(state->device.physical_device, &props);
+
+    state->draw_command_frame_size = align_up(sizeof(VkDrawIndexedIndirectCommand) * state->instance_capacity, props.limits.minStorageBufferOffsetAlignment);
+    state->draw_count_frame_size = align_up(sizeof(u32), props.limits.minStorageBufferOffsetAlignment);
+
+    create_buffer(state, state->draw_command_frame_size * state->frames_in_flight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->draw_command_buffer.buffer, &state->draw_command_buffer.allocation);
+    create_buffer(state, state->draw_count_frame_size * state->frames_in_flight, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state->draw_count_buffer.buffer, &state->draw_count_buffer.allocation);
 }
 
-void create_uniform_buffers(application_state* state)
+void destroy_cull_buffers(application_state* state)
 {
-    VkDeviceSize buffer_size = sizeof(uniform_buffer_object);
+    if (!state->gpu_culling) {
+        return;
+    }
 
-    state->uniform_buffers = (buffer*)calloc(MAX_FRAMES_IN_FLIGHT, sizeof(buffer));
-    state->uniform_buffers_mapped = (void**)calloc(MAX_FRAMES_IN_FLIGHT, sizeof(void*));
+    buffer* buffers[] = {&state->object_buffer, &state->draw_command_buffer, &state->draw_count_buffer};
 
-    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        create_buffer(state, buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &state->uniform_buffers[i].buffer, &state->uniform_buffers[i].memory);
-        vkMapMemory(state->device.device, state->uniform_buffers[i].memory, 0, buffer_size, 0, &state->uniform_buffers_mapped[i]);
+    for (u32 i = 0; i < sizeof(buffers) / sizeof(buffers[0]); ++i) {
+        vkDestroyBuffer(state->device.device, buffers[i]->buffer, NULL);
+        memory_allocator_free(&state->allocator, &buffers[i]->allocation);
     }
 }
 
-void destroy_uniform_buffers(application_state* state)
+void create_uniform_arena(application_state* state)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(state->device.physical_device, &props);
+
+    uniform_arena* arena = &state->uniforms;
+
+    arena->alignment = props.limits.minUniformBufferOffsetAlignment;
+    arena->frame_size = align_up(UNIFORM_ARENA_FRAME_SIZE, arena->alignment);
+    arena->frame_offset = 0;
+    arena->head = 0;
+
+    create_buffer(state, arena->frame_size * state->frames_in_flight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &arena->buffer.buffer, &arena->buffer.allocation);
+    arena->mapped = (u8*)arena->buffer.allocation.mapped;
+}
+
+void destroy_uniform_arena(application_state* state)
 {
-    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        vkDestroyBuffer(state->device.device, state->uniform_buffers[i].buffer, NULL);
-        vkFreeMemory(state->device.device, state->uniform_buffers[i].memory, NULL);
+    vkDestroyBuffer(state->device.device, state->uniforms.buffer.buffer, NULL);
+    memory_allocator_free(&state->allocator, &state->uniforms.buffer.allocation);
+}
+
+// the timeline has passed the frame's last use, so its whole region can be reused
+void begin_uniform_frame(application_state* state, u32 frame)
+{
+    state->uniforms.frame_offset = frame * state->uniforms.frame_size;
+    state->uniforms.head = 0;
+}
+
+// copies a block into the current frame's region and returns its dynamic offset
+u32 push_uniforms(application_state* state, const void* data, VkDeviceSize size)
+{
+    uniform_arena* arena = &state->uniforms;
+    VkDeviceSize offset = align_up(arena->head, arena->alignment);
+
+    if (offset + size > arena->frame_size) {
+        fprintf(stderr, "uniform arena exhausted\n");
+        return (u32)arena->frame_offset;
     }
+
+    memcpy(arena->mapped + arena->frame_offset + offset, data, size);
+    arena->head = offset + size;
+
+    return (u32)(arena->frame_offset + offset);
+}
+
+void compute_camera(VkExtent2D extent, uniform_buffer_object* ubo)
+{
+    glm_lookat((vec3){2.0f, 2.0f, 2.0f}, (vec3){0.0f, 0.0f, 0.0f}, (vec3){0.0f, 0.0f, 1.0f}, ubo->view);
+
+    glm_perspective(glm_rad(45.0f), (float)extent.width / (float)extent.height, 0.1f, 10.0f, ubo->projection);
+    ubo->projection[1][1] *= -1;
 }
 
-void update_uniform_buffer(application_state* state, u32 current_image, f32 dt)
+void update_uniform_buffer(application_state* state)
 {
     uniform_buffer_object ubo;
+    compute_camera(state->surface.extent, &ubo);
+
+    // kept for culling, which runs before the instances are written
+    mat4 view_projection;
+    glm_mat4_mul(ubo.projection, ubo.view, view_projection);
+    memcpy(state->view_projection, view_projection, sizeof(state->view_projection));
+
+    state->camera_offset = push_uniforms(state, &ubo, sizeof(ubo));
+}
 
-    glm_mat4_identity(ubo.model);
-    glm_rotate(ubo.model, dt * glm_rad(90.0f), (vec3){0.0f, 0.0f, 1.0f});
+// one persistently mapped storage buffer with a slice per frame in flight, sized for the largest instance count used
+void create_instance_buffer(application_state* state)
+{
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(state->device.physical_device, &props);
+
+    state->instance_frame_size = align_up(sizeof(instance_data) * state->instance_capacity, props.limits.minStorageBufferOffsetAlignment);
 
-    glm_lookat((vec3){2.0f, 2.0f, 2.0f}, (vec3){0.0f, 0.0f, 0.0f}, (vec3){0.0f, 0.0f, 1.0f}, ubo.view);
+    create_buffer(state, state->instance_frame_size * state->frames_in_flight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &state->instance_buffer.buffer, &state->instance_buffer.allocation);
+
+    scene_objects_create(&state->objects, state->instance_capacity);
+    state->object_instances = (instance_data*)calloc(state->instance_capacity, sizeof(instance_data));
+    state->visible_objects = (u32*)calloc(state->instance_capacity, sizeof(u32));
+
+    // only the matrices change per frame
+    for (u32 i = 0; i < state->instance_capacity; ++i) {
+        state->object_instances[i].material = i % INSTANCE_MATERIAL_COUNT;
+        state->object_instances[i].texture = state->texture_index;
+        state->object_instances[i].sampler = state->sampler_index;
+
+        for (u32 frame = 0; frame < state->frames_in_flight; ++frame) {
+            instance_data* instances = (instance_data*)((u8*)state->instance_buffer.allocation.mapped + frame * state->instance_frame_size);
+            instances[i].material = i % INSTANCE_MATERIAL_COUNT;
+            instances[i].texture = state->texture_index;
+            instances[i].sampler = state->sampler_index;
+        }
+    }
 
-    glm_perspective(glm_rad(45.0f), (float)state->surface.extent.width / (float)state->surface.extent.height, 0.1f, 10.0f, ubo.projection);
-    ubo.projection[1][1] *= -1;
+    // gpu culling writes every frame's slice of the mapped buffer, the cpu culler the single object_instances copy
+    transform_system_create(&state->transforms, state->instance_capacity + 1, state->gpu_culling ? state->frames_in_flight : 1);
 
-    memcpy(state->uniform_buffers_mapped[current_image], &ubo, sizeof(ubo));
+    // node 0 is the root every instance hangs off, instance i is node i + 1
+    transform_add(&state->transforms, TRANSFORM_NO_PARENT, TRANSFORM_NO_OUTPUT);
 }
 
-void create_descriptor_pool(application_state* state)
+void destroy_instance_buffer(application_state* state)
 {
-    VkDescriptorPoolSize pool_size[2];
-    pool_size[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_size[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+    vkDestroyBuffer(state->device.device, state->instance_buffer.buffer, NULL);
+    memory_allocator_free(&state->allocator, &state->instance_buffer.allocation);
 
-    pool_size[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    pool_size[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+    free(state->visible_objects);
+    free(state->object_instances);
+    scene_objects_destroy(&state->objects);
+    transform_system_destroy(&state->transforms);
+}
 
-    VkDescriptorPoolCreateInfo create_info;
-    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    create_info.pNext = NULL;
-    create_info.flags = 0;
-    create_info.maxSets = MAX_FRAMES_IN_FLIGHT;
-    create_info.poolSizeCount = sizeof(pool_size) / sizeof(pool_size[0]);
-    create_info.pPoolSizes = pool_size;
+// places count instances on a cube grid, only needed when the count changes
+void layout_instances(application_state* state, u32 count)
+{
+    u32 side = (u32)ceilf(cbrtf((f32)count));
+    while (side * side * side < count) {
+        side += 1;
+    }
+
+    f32 spacing = 2.0f / (f32)side;
+    f32 scale = side > 1 ? 0.4f * spacing : 1.0f;
 
-    if (vkCreateDescriptorPool(state->device.device, &create_info, NULL, &state->descriptor_pool) != VK_SUCCESS) {
-        fprintf(stderr, "failed to create descriptor pool\n");
+    while (state->transforms.count < count + 1) {
+        transform_add(&state->transforms, 0, state->transforms.count - 1);
     }
+
+    for (u32 i = 0; i < count; ++i) {
+        vec3 position = {
+            ((f32)(i % side) + 0.5f) * spacing - 1.0f,
+            ((f32)(i / side % side) + 0.5f) * spacing - 1.0f,
+            ((f32)(i / (side * side)) + 0.5f) * spacing - 1.0f
+        };
+
+        transform_set_translation(&state->transforms, i + 1, position);
+        transform_set_scale(&state->transforms, i + 1, (vec3){scale, scale, scale});
+    }
+
+    state->instance_layout_count = count;
+    state->instance_scale = scale;
+}
+
+void update_instances(application_state* state, u32 current_image, f32 dt)
+{
+    instance_data* instances = (instance_data*)((u8*)state->instance_buffer.allocation.mapped + current_image * state->instance_frame_size);
+    u32 count = state->instance_count;
+
+    state->elapsed_time += dt;
+
+    if (count != state->instance_layout_count) {
+        layout_instances(state, count);
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        versor rotation;
+        glm_quatv(rotation, state->elapsed_time * glm_rad(90.0f) + (f32)i * 0.1f, (vec3){0.0f, 0.0f, 1.0f});
+        transform_set_rotation(&state->transforms, i + 1, rotation);
+    }
+
+    // culled by cull.comp, which reads the instances in place
+    if (state->gpu_culling) {
+        transform_system_update(&state->transforms, current_image, (u8*)instances + offsetof(instance_data, model), sizeof(instance_data));
+        return;
+    }
+
+    transform_system_update(&state->transforms, 0, (u8*)state->object_instances + offsetof(instance_data, model), sizeof(instance_data));
+
+    for (u32 i = 0; i < count; ++i) {
+        if (!state->transforms.changed[i + 1]) {
+            continue;
+        }
+
+        const f32* model = state->transforms.world + (u64)(i + 1) * 16;
+
+        // world box of the rotated local box, and a sphere around the same center
+        vec3 center;
+        vec3 extent;
+        for (u32 r = 0; r < 3; ++r) {
+            center[r] = model[r] * state->mesh_center[0] + model[4 + r] * state->mesh_center[1] + model[8 + r] * state->mesh_center[2] + model[12 + r];
+            extent[r] = fabsf(model[r]) * state->mesh_extent[0] + fabsf(model[4 + r]) * state->mesh_extent[1] + fabsf(model[8 + r]) * state->mesh_extent[2];
+        }
+
+        vec3 min;
+        vec3 max;
+        glm_vec3_sub(center, extent, min);
+        glm_vec3_add(center, extent, max);
+
+        scene_objects_set_bounds(&state->objects, i, center, state->instance_scale * glm_vec3_norm(state->mesh_extent), min, max);
+    }
+
+    state->objects.count = count;
+
+    cull_frustum frustum;
+    cull_frustum_extract(&frustum, state->view_projection);
+
+    state->visible_count = cull_objects(&state->objects, &frustum, state->visible_objects);
+
+    // gl_InstanceIndex walks the visible objects, packed at the start of the frame's slice
+    for (u32 i = 0; i < state->visible_count; ++i) {
+        instances[i] = state->object_instances[state->visible_objects[i]];
+    }
+}
+
+// set 0 lives as long as the device, the cull set is transient and allocated per frame in flight
+void create_descriptor_allocator(application_state* state)
+{
+    descriptor_allocator_create(&state->descriptors, state->device.device, state->frames_in_flight);
 }
 
-void destroy_descriptor_pool(application_state* state)
+void destroy_descriptor_allocator(application_state* state)
 {
-    vkDestroyDescriptorPool(state->device.device, state->descriptor_pool, NULL);
+    descriptor_allocator_destroy(&state->descriptors);
 }
 
+// a single set serves every frame, the per-frame buffers are selected by dynamic offsets at bind time
 void create_descriptor_sets(application_state* state)
 {
-    state->descriptor_sets = (VkDescriptorSet*)calloc(MAX_FRAMES_IN_FLIGHT, sizeof(VkDescriptorSet));
+    state->descriptor_set = descriptor_allocator_allocate(&state->descriptors, DESCRIPTOR_PERSISTENT, state->descriptor_set_layout);
+
+    VkDescriptorBufferInfo buffer_info;
+    buffer_info.buffer = state->uniforms.buffer.buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = sizeof(uniform_buffer_object);
+
+    VkDescriptorImageInfo image_info;
+    image_info.sampler = state->texture_sampler;
+    image_info.imageView = state->texture_image_view;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkDescriptorBufferInfo instance_info;
+    instance_info.buffer = state->instance_buffer.buffer;
+    instance_info.offset = 0;
+    instance_info.range = sizeof(instance_data) * state->instance_capacity;
+
+    VkWriteDescriptorSet descriptor_writes[3];
+    descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptor_writes[0].pNext = NULL;
+    descriptor_writes[0].dstSet = state->descriptor_set;
+    descriptor_writes[0].dstBinding = 0;
+    descriptor_writes[0].dstArrayElement = 0;
+    descriptor_writes[0].descriptorCount = 1;
+    descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptor_writes[0].pImageInfo = NULL;
+    descriptor_writes[0].pBufferInfo = &buffer_info;
+    descriptor_writes[0].pTexelBufferView = NULL;
+
+    descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptor_writes[1].pNext = NULL;
+    descriptor_writes[1].dstSet = state->descriptor_set;
+    descriptor_writes[1].dstBinding = 1;
+    descriptor_writes[1].dstArrayElement = 0;
+    descriptor_writes[1].descriptorCount = 1;
+    descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptor_writes[1].pImageInfo = &image_info;
+    descriptor_writes[1].pBufferInfo = NULL;
+    descriptor_writes[1].pTexelBufferView = NULL;
+
+    descriptor_writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptor_writes[2].pNext = NULL;
+    descriptor_writes[2].dstSet = state->descriptor_set;
+    descriptor_writes[2].dstBinding = 2;
+    descriptor_writes[2].dstArrayElement = 0;
+    descriptor_writes[2].descriptorCount = 1;
+    descriptor_writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    descriptor_writes[2].pImageInfo = NULL;
+    descriptor_writes[2].pBufferInfo = &instance_info;
+    descriptor_writes[2].pTexelBufferView = NULL;
+
+    // bindless mode has no binding 1, the texture lives in the table
+    if (state->bindless) {
+        descriptor_writes[1] = descriptor_writes[2];
+    }
+
+    vkUpdateDescriptorSets(state->device.device, state->bindless ? 2 : 3, descriptor_writes, 0, NULL);
+}
+
+int compare_f64(const void* a, const void* b)
+{
+    f64 lhs = *(const f64*)a;
+    f64 rhs = *(const f64*)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// returns the mean frame time in milliseconds
+f64 run_benchmark(application_state* state)
+{
+    f64* frame_times = (f64*)calloc(state->benchmark_frames, sizeof(f64));
+
+    printf("benchmark: %u frames at %ux%u, %u instances in %u draws on %u threads (%u warmup)\n", state->benchmark_frames, state->surface.extent.width, state->surface.extent.height, state->instance_count, state->draw_count < state->instance_count ? state->draw_count : state->instance_count, state->record_thread_count, BENCHMARK_WARMUP_FRAMES);
+
+    state->last_time = frame_clock_now();
+
+    for (u32 i = 0; i < BENCHMARK_WARMUP_FRAMES + state->benchmark_frames; ++i) {
+        if (i == BENCHMARK_WARMUP_FRAMES) {
+            frame_stats_reset(&state->stats);
+        }
+
+        f32 dt = frame_clock_tick(&state->last_time);
+
+        draw_frame(state, dt);
 
-    VkDescriptorSetLayout layouts[MAX_FRAMES_IN_FLIGHT];
-    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        layouts[i] = state->descriptor_set_layout;
+        if (i >= BENCHMARK_WARMUP_FRAMES) {
+            frame_times[i - BENCHMARK_WARMUP_FRAMES] = (f64)(frame_clock_now() - state->last_time) * 1e-6;
+        }
     }
 
-    VkDescriptorSetAllocateInfo allocate_info;
-    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocate_info.pNext = NULL;
-    allocate_info.descriptorPool = state->descriptor_pool;
-    allocate_info.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
-    allocate_info.pSetLayouts = layouts;
-
-    if (vkAllocateDescriptorSets(state->device.device, &allocate_info, state->descriptor_sets) != VK_SUCCESS) {
-        fprintf(stderr, "failed to allocated descriptor sets\n");
-    }
-
-    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        VkDescriptorBufferInfo buffer_info;
-        buffer_info.buffer = state->uniform_buffers[i].buffer;
-        buffer_info.offset = 0;
-        buffer_info.range = sizeof(uniform_buffer_object);
-
-        VkDescriptorImageInfo image_info;
-        image_info.sampler = state->texture_sampler;
-        image_info.imageView = state->texture_image_view;
-        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        VkWriteDescriptorSet descriptor_writes[2];
-        descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptor_writes[0].pNext = NULL;
-        descriptor_writes[0].dstSet = state->descriptor_sets[i];
-        descriptor_writes[0].dstBinding = 0;
-        descriptor_writes[0].dstArrayElement = 0;
-        descriptor_writes[0].descriptorCount = 1;
-        descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptor_writes[0].pImageInfo = NULL;
-        descriptor_writes[0].pBufferInfo = &buffer_info;
-        descriptor_writes[0].pTexelBufferView = NULL;
-
-        descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptor_writes[1].pNext = NULL;
-        descriptor_writes[1].dstSet = state->descriptor_sets[i];
-        descriptor_writes[1].dstBinding = 1;
-        descriptor_writes[1].dstArrayElement = 0;
-        descriptor_writes[1].descriptorCount = 1;
-        descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptor_writes[1].pImageInfo = &image_info;
-        descriptor_writes[1].pBufferInfo = NULL;
-        descriptor_writes[1].pTexelBufferView = NULL;
-
-        vkUpdateDescriptorSets(state->device.device, sizeof(descriptor_writes) / sizeof(descriptor_writes[0]), descriptor_writes, 0, NULL);
-    }
-}
-
-int main(void)
+    vkDeviceWaitIdle(state->device.device);
+
+    u32 count = state->benchmark_frames;
+
+    f64 total = 0.0;
+    for (u32 i = 0; i < count; ++i) {
+        total += frame_times[i];
+    }
+
+    qsort(frame_times, count, sizeof(f64), compare_f64);
+
+    f64 mean = total / count;
+    f64 median = count % 2 ? frame_times[count / 2] : (frame_times[count / 2 - 1] + frame_times[count / 2]) * 0.5;
+    f64 p99 = frame_times[(u32)ceil(count * 0.99) - 1];
+    f64 max = frame_times[count - 1];
+
+    printf("frame time (ms): mean %.3f, median %.3f, p99 %.3f, max %.3f\n", mean, median, p99, max);
+
+    free(frame_times);
+
+    return mean;
+}
+
+// reruns the benchmark with 4x more instances each step, up to INSTANCE_SWEEP_MAX
+void run_instance_sweep(application_state* state)
+{
+    printf("%10s %12s %12s %14s\n", "instances", "frame (ms)", "gpu (ms)", "cpu/inst (ns)");
+
+    for (u32 count = 1; count <= state->instance_capacity; count *= 4) {
+        state->instance_count = count;
+
+        f64 mean = run_benchmark(state);
+
+        const frame_histogram* gpu = &state->stats.stages[FRAME_STAGE_GPU_DRAW];
+        const frame_histogram* record = &state->stats.stages[FRAME_STAGE_RECORD];
+
+        f64 gpu_mean = gpu->count > 0 ? (f64)gpu->sum / (f64)gpu->count * 1e-6 : 0.0;
+        f64 record_mean = record->count > 0 ? (f64)record->sum / (f64)record->count : 0.0;
+
+        printf("%10u %12.3f %12.3f %14.2f\n", count, mean, gpu_mean, record_mean / count);
+    }
+}
+
+// culls a random scene against the default camera with the scalar and the simd path
+void run_cull_benchmark(void)
+{
+    scene_objects objects;
+    scene_objects_create(&objects, CULL_BENCHMARK_OBJECTS);
+    objects.count = CULL_BENCHMARK_OBJECTS;
+
+    u32 seed = 1;
+    for (u32 i = 0; i < objects.count; ++i) {
+        f32 center[3];
+        for (u32 c = 0; c < 3; ++c) {
+            seed = seed * 1664525u + 1013904223u;
+            center[c] = ((f32)(seed >> 8) / 16777216.0f) * 8.0f - 4.0f;
+        }
+
+        f32 radius = 0.05f;
+        f32 min[3] = {center[0] - radius, center[1] - radius, center[2] - radius};
+        f32 max[3] = {center[0] + radius, center[1] + radius, center[2] + radius};
+
+        scene_objects_set_bounds(&objects, i, center, radius, min, max);
+    }
+
+    uniform_buffer_object ubo;
+    compute_camera((VkExtent2D){HEADLESS_WIDTH, HEADLESS_HEIGHT}, &ubo);
+
+    mat4 view_projection;
+    glm_mat4_mul(ubo.projection, ubo.view, view_projection);
+
+    cull_frustum frustum;
+    cull_frustum_extract(&frustum, (const f32*)view_projection);
+
+    u32* visible = (u32*)calloc(objects.count, sizeof(u32));
+
+    printf("cull benchmark: %u objects, %u iterations\n", objects.count, CULL_BENCHMARK_ITERATIONS);
+
+    const char* names[] = {"scalar", cull_simd_name()};
+    u32 (*cullers[])(const scene_objects*, const cull_frustum*, u32*) = {cull_objects_scalar, cull_objects};
+
+    for (u32 c = 0; c < 2; ++c) {
+        u32 count = 0;
+        u64 start = frame_clock_now();
+
+        for (u32 i = 0; i < CULL_BENCHMARK_ITERATIONS; ++i) {
+            count = cullers[c](&objects, &frustum, visible);
+        }
+
+        f64 ms = (f64)(frame_clock_now() - start) * 1e-6;
+
+        printf("%8s: %u visible, %.0f objects/ms\n", names[c], count, (f64)objects.count * CULL_BENCHMARK_ITERATIONS / ms);
+    }
+
+    free(visible);
+    scene_objects_destroy(&objects);
+}
+
+void parse_arguments(application_state* state, int argc, char** argv)
+{
+    state->benchmark_frames = BENCHMARK_DEFAULT_FRAMES;
+    state->instance_count = 1;
+    state->draw_count = 1;
+    state->frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+    state->requested_present_mode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+    state->record_thread_count = decode_pool_default_thread_count() + 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            state->headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            long frames = strtol(argv[++i], NULL, 10);
+            state->benchmark_frames = frames > 0 ? (u32)frames : BENCHMARK_DEFAULT_FRAMES;
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            long instances = strtol(argv[++i], NULL, 10);
+            state->instance_count = instances > 0 ? (u32)instances : 1;
+        } else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+            long draws = strtol(argv[++i], NULL, 10);
+            state->draw_count = draws > 0 ? (u32)draws : 1;
+        } else if (strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc) {
+            long threads = strtol(argv[++i], NULL, 10);
+            state->record_thread_count = threads > 0 ? (u32)threads : 1;
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            long frames = strtol(argv[++i], NULL, 10);
+            state->frames_in_flight = frames < 1 ? 1 : frames > MAX_FRAMES_IN_FLIGHT ? MAX_FRAMES_IN_FLIGHT : (u32)frames;
+        } else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+
+            if (strcmp(mode, "immediate") == 0) {
+                state->requested_present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            } else if (strcmp(mode, "mailbox") == 0) {
+                state->requested_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+            } else if (strcmp(mode, "fifo") == 0) {
+                state->requested_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+            } else if (strcmp(mode, "fifo-relaxed") == 0) {
+                state->requested_present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+            } else {
+                fprintf(stderr, "unknown present mode: %s\n", mode);
+            }
+        } else if (strcmp(argv[i], "--swapchain-images") == 0 && i + 1 < argc) {
+            long images = strtol(argv[++i], NULL, 10);
+            state->requested_image_count = images > 0 ? (u32)images : 0;
+        } else if (strcmp(argv[i], "--gpu-cull") == 0) {
+            state->gpu_culling = true;
+        } else if (strcmp(argv[i], "--bindless") == 0) {
+            state->bindless = true;
+        } else if (strcmp(argv[i], "--hot-reload") == 0) {
+            state->hot_reload = true;
+        } else if (strcmp(argv[i], "--cull-benchmark") == 0) {
+            state->cull_benchmark = true;
+        } else if (strcmp(argv[i], "--instance-sweep") == 0) {
+            state->headless = true;
+            state->instance_sweep = true;
+        } else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+        }
+    }
+
+    state->instance_capacity = state->instance_sweep ? INSTANCE_SWEEP_MAX : state->instance_count;
+
+    if (state->record_thread_count > MAX_RECORD_THREADS) {
+        state->record_thread_count = MAX_RECORD_THREADS;
+    }
+}
+
+int main(int argc, char** argv)
 {
     application_state* state = (application_state*)malloc(sizeof(application_state));
     state = memset(state, 0, sizeof(application_state));
 
-    QueryPerformanceFrequency(&clock_frequency);
+    parse_arguments(state, argc, argv);
+    frame_stats_reset(&state->stats);
+
+    // cpu only, no device needed
+    if (state->cull_benchmark) {
+        run_cull_benchmark();
+        free(state);
+        return 0;
+    }
 
-    initialize_window(state);
+    if (!state->headless) {
+        initialize_window(state);
+    }
 
     if (volkInitialize() != VK_SUCCESS) {
         fprintf(stderr, "failed to initialize vulkan loader\n");
@@ -1608,73 +4803,125 @@ int main(void)
     }
 
     create_instance(state);
-    create_surface(state);
+
+    if (!state->headless) {
+        create_surface(state);
+    }
+
     pick_physical_device(state);
     create_device(state);
-    create_swapchain(state);
+    memory_allocator_create(&state->allocator, state->device.physical_device, state->device.device);
+    create_pipeline_cache(state);
+
+    start_asset_decode(state);
+
+    if (state->headless) {
+        create_offscreen_targets(state);
+    } else {
+        create_swapchain(state);
+    }
+
     create_render_pass(state);
     create_framebuffers(state);
+    create_descriptor_layout_cache(state);
     create_descriptor_set_layout(state);
+    create_texture_table(state);
     create_graphics_pipeline(state);
+    create_cull_pipeline(state);
+    create_shader_reload(state);
+    create_latency_waiter(state);
     create_command_pool(state);
     allocate_command_buffer(state);
     create_sync_objects(state);
+    create_timestamp_queries(state);
+    create_staging_ring(state);
+    create_upload_context(state);
     create_texture_image(state);
     create_texture_sampler(state);
-    create_vertex_buffer(state);
-    create_index_buffer(state);
-    create_uniform_buffers(state);
-    create_descriptor_pool(state);
+    create_mesh(state);
+    create_cull_buffers(state);
+    flush_uploads(state);
+    finish_asset_decode(state);
+    create_uniform_arena(state);
+    create_instance_buffer(state);
+    create_descriptor_allocator(state);
     create_descriptor_sets(state);
 
-    QueryPerformanceCounter(&state->last_time);
-
-    while (!glfwWindowShouldClose(state->window)) {
-        LARGE_INTEGER current_time;
-        QueryPerformanceCounter(&current_time);
-
-        f32 dt = (f32)(current_time.QuadPart - state->last_time.QuadPart) / clock_frequency.QuadPart;
-        state->last_time = current_time;
+    if (state->instance_sweep) {
+        run_instance_sweep(state);
+    } else if (state->headless) {
+        run_benchmark(state);
+    } else {
+        state->last_time = frame_clock_now();
 
-        // printf("delta time: %f\n", dt);
+        while (!glfwWindowShouldClose(state->window)) {
+            f32 dt = frame_clock_tick(&state->last_time);
 
-        glfwPollEvents();
+            glfwPollEvents();
 
-        draw_frame(state, dt);
+            draw_frame(state, dt);
+        }
     }
 
+    frame_stats_print(&state->stats, stdout);
+    memory_allocator_print_stats(&state->allocator, stdout);
+
     vkDeviceWaitIdle(state->device.device);
 
-    destroy_descriptor_pool(state);
+    destroy_descriptor_allocator(state);
+    destroy_upload_context(state);
+    destroy_staging_ring(state);
+    destroy_cull_buffers(state);
     destroy_index_buffer(state);
     destroy_vertex_buffer(state);
     destroy_texture_sampler(state);
     destroy_texture_image(state);
+    destroy_timestamp_queries(state);
     destroy_sync_objects(state);
     destroy_command_pool(state);
+    destroy_latency_waiter(state);
+    destroy_shader_reload(state);
+    destroy_cull_pipeline(state);
     destroy_graphics_pipeline(state);
-    destroy_uniform_buffers(state);
-    destroy_descriptor_set_layout(state);
+    destroy_pipeline_cache(state);
+    destroy_instance_buffer(state);
+    destroy_uniform_arena(state);
+    destroy_texture_table(state);
+    destroy_descriptor_layout_cache(state);
+    release_retired_swapchains(state, true);
     destroy_framebuffers(state);
     destroy_render_pass(state);
-    destroy_swapchain(state);
+
+    if (state->headless) {
+        destroy_offscreen_targets(state);
+    } else {
+        destroy_swapchain(state);
+    }
+
+    memory_allocator_destroy(&state->allocator);
     destroy_device(state);
-    destroy_surface(state);
+
+    if (!state->headless) {
+        destroy_surface(state);
+    }
+
     destroy_instance(state);
 
-    free(state->descriptor_sets);
-    free(state->uniform_buffers_mapped);
-    free(state->uniform_buffers);
-    free(state->in_flight_fences);
+    free(state->timestamps.query_counts);
+    free(state->timestamps.query_pools);
+    free(state->frame_values);
     free(state->render_finished_semaphores);
     free(state->image_available_semaphores);
     free(state->command_buffers);
     free(state->framebuffers);
     free(state->swapchain.image_views);
     free(state->swapchain.images);
+    free(state->offscreen_images);
 
-    glfwDestroyWindow(state->window);
-    glfwTerminate();
+    if (!state->headless) {
+        glfwDestroyWindow(state->window);
+        glfwTerminate();
+    }
 
     free(state);
 
@@ -0,0 +1,476 @@
+#include "mesh.h"
+
+#define MESH_EMPTY_SLOT UINT32_MAX
+
+// forsyth's scoring constants
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+static u32 hash_vertex(const mesh_vertex* vertex)
+{
+    const u8* bytes = (const u8*)vertex;
+    u32 hash = 2166136261u;
+
+    for (u32 i = 0; i < sizeof(mesh_vertex); ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+void mesh_build_indexed(mesh* mesh, const mesh_vertex* vertices, u32 count)
+{
+    // at most half full
+    u32 capacity = 1;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+    }
+
+    u32* table = (u32*)malloc(sizeof(u32) * capacity);
+    memset(table, 0xff, sizeof(u32) * capacity);
+
+    mesh->vertices = (mesh_vertex*)malloc(sizeof(mesh_vertex) * (count > 0 ? count : 1));
+    mesh->indices = (u32*)malloc(sizeof(u32) * (count > 0 ? count : 1));
+    mesh->vertex_count = 0;
+    mesh->index_count = count;
+
+    for (u32 i = 0; i < count; ++i) {
+        u32 slot = hash_vertex(&vertices[i]) & (capacity - 1);
+
+        while (table[slot] != MESH_EMPTY_SLOT && memcmp(&mesh->vertices[table[slot]], &vertices[i], sizeof(mesh_vertex)) != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        if (table[slot] == MESH_EMPTY_SLOT) {
+            table[slot] = mesh->vertex_count;
+            mesh->vertices[mesh->vertex_count++] = vertices[i];
+        }
+
+        mesh->indices[i] = table[slot];
+    }
+
+    free(table);
+
+    mesh->vertices = (mesh_vertex*)realloc(mesh->vertices, sizeof(mesh_vertex) * (mesh->vertex_count > 0 ? mesh->vertex_count : 1));
+}
+
+typedef struct obj_corner {
+    i64 position;
+    i64 tex_coord;
+} obj_corner;
+
+// obj indices are 1 based, negative ones count back from the newest element
+static i64 resolve_obj_index(i64 index, u32 count)
+{
+    if (index > 0) {
+        return index - 1 < count ? index - 1 : -1;
+    }
+
+    if (index < 0) {
+        return -index <= count ? (i64)count + index : -1;
+    }
+
+    return -1;
+}
+
+static void push_vertex(mesh_vertex** vertices, u32* count, u32* capacity, mesh_vertex vertex)
+{
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 1024;
+        *vertices = (mesh_vertex*)realloc(*vertices, sizeof(mesh_vertex) * *capacity);
+    }
+
+    (*vertices)[(*count)++] = vertex;
+}
+
+bool mesh_load_obj(mesh* mesh, const char* path)
+{
+    memset(mesh, 0, sizeof(*mesh));
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size < 0) {
+        fclose(file);
+        return false;
+    }
+
+    char* text = (char*)malloc((size_t)size + 1);
+    size_t read = fread(text, 1, (size_t)size, file);
+    text[read] = '\0';
+    fclose(file);
+
+    f32* positions = NULL;
+    f32* colors = NULL;
+    f32* tex_coords = NULL;
+    u32 position_count = 0;
+    u32 position_capacity = 0;
+    u32 tex_coord_count = 0;
+    u32 tex_coord_capacity = 0;
+
+    mesh_vertex* soup = NULL;
+    u32 soup_count = 0;
+    u32 soup_capacity = 0;
+
+    char* line = text;
+    while (line && *line) {
+        char* next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+
+        if (line[0] == 'v' && line[1] == ' ') {
+            if (position_count == position_capacity) {
+                position_capacity = position_capacity ? position_capacity * 2 : 1024;
+                positions = (f32*)realloc(positions, sizeof(f32) * 3 * position_capacity);
+                colors = (f32*)realloc(colors, sizeof(f32) * 3 * position_capacity);
+            }
+
+            f32* p = &positions[position_count * 3];
+            f32* c = &colors[position_count * 3];
+            c[0] = c[1] = c[2] = 1.0f;
+
+            int fields = sscanf(line + 2, "%f %f %f %f %f %f", &p[0], &p[1], &p[2], &c[0], &c[1], &c[2]);
+            if (fields < 6) {
+                c[0] = c[1] = c[2] = 1.0f;
+            }
+
+            position_count += 1;
+        } else if (line[0] == 'v' && line[1] == 't' && line[2] == ' ') {
+            if (tex_coord_count == tex_coord_capacity) {
+                tex_coord_capacity = tex_coord_capacity ? tex_coord_capacity * 2 : 1024;
+                tex_coords = (f32*)realloc(tex_coords, sizeof(f32) * 2 * tex_coord_capacity);
+            }
+
+            f32* t = &tex_coords[tex_coord_count * 2];
+            t[0] = t[1] = 0.0f;
+            sscanf(line + 3, "%f %f", &t[0], &t[1]);
+
+            // obj puts the origin at the bottom left
+            t[1] = 1.0f - t[1];
+            tex_coord_count += 1;
+        } else if (line[0] == 'f' && line[1] == ' ') {
+            obj_corner corners[3];
+            u32 corner_count = 0;
+
+            char* cursor = line + 2;
+            while (*cursor) {
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') {
+                    ++cursor;
+                }
+                if (!*cursor) {
+                    break;
+                }
+
+                obj_corner corner = { -1, -1 };
+                corner.position = resolve_obj_index(strtoll(cursor, &cursor, 10), position_count);
+
+                if (*cursor == '/') {
+                    ++cursor;
+                    if (*cursor != '/') {
+                        corner.tex_coord = resolve_obj_index(strtoll(cursor, &cursor, 10), tex_coord_count);
+                    }
+                    if (*cursor == '/') {
+                        ++cursor;
+                        strtoll(cursor, &cursor, 10);
+                    }
+                }
+
+                while (*cursor && *cursor != ' ' && *cursor != '\t' && *cursor != '\r') {
+                    ++cursor;
+                }
+
+                if (corner.position < 0) {
+                    corner_count = 0;
+                    break;
+                }
+
+                // polygons are split into a fan around their first corner
+                if (corner_count == 3) {
+                    corners[1] = corners[2];
+                    corner_count = 2;
+                }
+                corners[corner_count++] = corner;
+
+                if (corner_count < 3) {
+                    continue;
+                }
+
+                for (u32 i = 0; i < 3; ++i) {
+                    mesh_vertex vertex;
+                    memcpy(vertex.position, &positions[corners[i].position * 3], sizeof(vertex.position));
+                    memcpy(vertex.color, &colors[corners[i].position * 3], sizeof(vertex.color));
+
+                    if (corners[i].tex_coord >= 0) {
+                        memcpy(vertex.tex_coord, &tex_coords[corners[i].tex_coord * 2], sizeof(vertex.tex_coord));
+                    } else {
+                        vertex.tex_coord[0] = 0.0f;
+                        vertex.tex_coord[1] = 0.0f;
+                    }
+
+                    push_vertex(&soup, &soup_count, &soup_capacity, vertex);
+                }
+            }
+        }
+
+        line = next;
+    }
+
+    mesh_build_indexed(mesh, soup, soup_count);
+
+    free(soup);
+    free(tex_coords);
+    free(colors);
+    free(positions);
+    free(text);
+
+    return mesh->index_count > 0;
+}
+
+static f32 vertex_score(i32 cache_position, u32 active_triangles)
+{
+    if (active_triangles == 0) {
+        return -1.0f;
+    }
+
+    f32 score = 0.0f;
+
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            score = LAST_TRIANGLE_SCORE;
+        } else {
+            f32 scale = 1.0f / (MESH_VERTEX_CACHE_SIZE - 3);
+            score = powf(1.0f - (f32)(cache_position - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+
+    return score + VALENCE_BOOST_SCALE * powf((f32)active_triangles, -VALENCE_BOOST_POWER);
+}
+
+void mesh_optimize_vertex_cache(mesh* mesh)
+{
+    u32 triangle_count = mesh->index_count / 3;
+    u32 vertex_count = mesh->vertex_count;
+
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // triangles adjacent to each vertex, packed by vertex
+    u32* adjacency_offsets = (u32*)calloc(vertex_count + 1, sizeof(u32));
+    u32* active_counts = (u32*)calloc(vertex_count, sizeof(u32));
+    u32* adjacency = (u32*)malloc(sizeof(u32) * triangle_count * 3);
+    i32* cache_positions = (i32*)malloc(sizeof(i32) * vertex_count);
+    f32* vertex_scores = (f32*)malloc(sizeof(f32) * vertex_count);
+    f32* triangle_scores = (f32*)malloc(sizeof(f32) * triangle_count);
+    bool* emitted = (bool*)calloc(triangle_count, sizeof(bool));
+    u32* output = (u32*)malloc(sizeof(u32) * triangle_count * 3);
+
+    for (u32 i = 0; i < triangle_count * 3; ++i) {
+        active_counts[mesh->indices[i]] += 1;
+    }
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        adjacency_offsets[i + 1] = adjacency_offsets[i] + active_counts[i];
+        active_counts[i] = 0;
+    }
+
+    for (u32 i = 0; i < triangle_count * 3; ++i) {
+        u32 v = mesh->indices[i];
+        adjacency[adjacency_offsets[v] + active_counts[v]++] = i / 3;
+    }
+
+    for (u32 i = 0; i < vertex_count; ++i) {
+        cache_positions[i] = -1;
+        vertex_scores[i] = vertex_score(-1, active_counts[i]);
+    }
+
+    u32 best_triangle = 0;
+    f32 best_score = -1.0f;
+
+    for (u32 i = 0; i < triangle_count; ++i) {
+        const u32* tri = &mesh->indices[i * 3];
+        triangle_scores[i] = vertex_scores[tri[0]] + vertex_scores[tri[1]] + vertex_scores[tri[2]];
+
+        if (triangle_scores[i] > best_score) {
+            best_score = triangle_scores[i];
+            best_triangle = i;
+        }
+    }
+
+    // three extra slots hold the vertices pushed out by the newest triangle
+    u32 cache[MESH_VERTEX_CACHE_SIZE + 3];
+    u32 cache_count = 0;
+    u32 scan_cursor = 0;
+
+    for (u32 emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+        if (best_score < 0.0f) {
+            // nothing in the cache touches a pending triangle, take the next one in order
+            while (emitted[scan_cursor]) {
+                ++scan_cursor;
+            }
+            best_triangle = scan_cursor;
+        }
+
+        const u32* tri = &mesh->indices[best_triangle * 3];
+        memcpy(&output[emitted_count * 3], tri, sizeof(u32) * 3);
+        emitted[best_triangle] = true;
+
+        u32 new_cache[MESH_VERTEX_CACHE_SIZE + 3];
+        u32 new_count = 0;
+
+        for (u32 i = 0; i < 3; ++i) {
+            u32 v = tri[i];
+
+            // drop the triangle from the vertex's pending list
+            u32* list = &adjacency[adjacency_offsets[v]];
+            for (u32 j = 0; j < active_counts[v]; ++j) {
+                if (list[j] == best_triangle) {
+                    list[j] = list[active_counts[v] - 1];
+                    break;
+                }
+            }
+            active_counts[v] -= 1;
+
+            new_cache[new_count++] = v;
+        }
+
+        for (u32 i = 0; i < cache_count; ++i) {
+            u32 v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache[new_count++] = v;
+            }
+        }
+
+        for (u32 i = 0; i < new_count; ++i) {
+            cache_positions[new_cache[i]] = i < MESH_VERTEX_CACHE_SIZE ? (i32)i : -1;
+        }
+
+        best_score = -1.0f;
+
+        for (u32 i = 0; i < new_count; ++i) {
+            u32 v = new_cache[i];
+            f32 score = vertex_score(cache_positions[v], active_counts[v]);
+            f32 delta = score - vertex_scores[v];
+            vertex_scores[v] = score;
+
+            const u32* list = &adjacency[adjacency_offsets[v]];
+            for (u32 j = 0; j < active_counts[v]; ++j) {
+                u32 t = list[j];
+                triangle_scores[t] += delta;
+
+                if (triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best_triangle = t;
+                }
+            }
+        }
+
+        cache_count = new_count < MESH_VERTEX_CACHE_SIZE ? new_count : MESH_VERTEX_CACHE_SIZE;
+        memcpy(cache, new_cache, sizeof(u32) * cache_count);
+    }
+
+    memcpy(mesh->indices, output, sizeof(u32) * triangle_count * 3);
+
+    free(output);
+    free(emitted);
+    free(triangle_scores);
+    free(vertex_scores);
+    free(cache_positions);
+    free(adjacency);
+    free(active_counts);
+    free(adjacency_offsets);
+}
+
+void mesh_optimize_vertex_fetch(mesh* mesh)
+{
+    u32* remap = (u32*)malloc(sizeof(u32) * (mesh->vertex_count > 0 ? mesh->vertex_count : 1));
+    memset(remap, 0xff, sizeof(u32) * mesh->vertex_count);
+
+    mesh_vertex* vertices = (mesh_vertex*)malloc(sizeof(mesh_vertex) * (mesh->vertex_count > 0 ? mesh->vertex_count : 1));
+    u32 next = 0;
+
+    for (u32 i = 0; i < mesh->index_count; ++i) {
+        u32 v = mesh->indices[i];
+
+        if (remap[v] == MESH_EMPTY_SLOT) {
+            remap[v] = next;
+            vertices[next++] = mesh->vertices[v];
+        }
+
+        mesh->indices[i] = remap[v];
+    }
+
+    // vertices no triangle references are dropped
+    free(mesh->vertices);
+    free(remap);
+
+    mesh->vertices = vertices;
+    mesh->vertex_count = next;
+}
+
+f32 mesh_acmr(const mesh* mesh)
+{
+    if (mesh->index_count < 3) {
+        return 0.0f;
+    }
+
+    u32 cache[MESH_VERTEX_CACHE_SIZE];
+    u32 cache_count = 0;
+    u32 cache_head = 0;
+    u32 misses = 0;
+
+    for (u32 i = 0; i < mesh->index_count; ++i) {
+        u32 v = mesh->indices[i];
+        bool hit = false;
+
+        for (u32 j = 0; j < cache_count; ++j) {
+            hit = hit || cache[j] == v;
+        }
+
+        if (hit) {
+            continue;
+        }
+
+        misses += 1;
+        cache[cache_head] = v;
+        cache_head = (cache_head + 1) % MESH_VERTEX_CACHE_SIZE;
+        cache_count = cache_count < MESH_VERTEX_CACHE_SIZE ? cache_count + 1 : cache_count;
+    }
+
+    return (f32)misses / (f32)(mesh->index_count / 3);
+}
+
+u32 mesh_index_size(const mesh* mesh)
+{
+    return mesh->vertex_count <= UINT16_MAX + 1u ? 2 : 4;
+}
+
+void mesh_write_indices(const mesh* mesh, void* dst)
+{
+    if (mesh_index_size(mesh) == 4) {
+        memcpy(dst, mesh->indices, sizeof(u32) * mesh->index_count);
+        return;
+    }
+
+    u16* indices = (u16*)dst;
+    for (u32 i = 0; i < mesh->index_count; ++i) {
+        indices[i] = (u16)mesh->indices[i];
+    }
+}
+
+void mesh_destroy(mesh* mesh)
+{
+    free(mesh->vertices);
+    free(mesh->indices);
+
+    memset(mesh, 0, sizeof(*mesh));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "defines.h"
+
+// fifo size the vertex cache optimizer and the acmr estimate assume
+#define MESH_VERTEX_CACHE_SIZE 32
+
+typedef struct mesh_vertex {
+    f32 position[3];
+    f32 color[3];
+    f32 tex_coord[2];
+} mesh_vertex;
+
+typedef struct mesh {
+    mesh_vertex* vertices;
+    u32 vertex_count;
+    u32* indices;
+    u32 index_count;
+} mesh;
+
+// triangulated wavefront obj, "v x y z [r g b]", "vt u v" and "f" with any of the v, v/vt, v//vn and v/vt/vn forms
+bool mesh_load_obj(mesh* mesh, const char* path);
+
+// indexes a triangle list, bitwise identical vertices are merged through an open addressing hash table
+void mesh_build_indexed(mesh* mesh, const mesh_vertex* vertices, u32 count);
+
+// reorders triangles for the post-transform cache (forsyth), then vertices by first use for fetch locality
+void mesh_optimize_vertex_cache(mesh* mesh);
+void mesh_optimize_vertex_fetch(mesh* mesh);
+
+// average transformed vertices per triangle with a MESH_VERTEX_CACHE_SIZE fifo
+f32 mesh_acmr(const mesh* mesh);
+
+// 2 when every index fits in 16 bits, 4 otherwise
+u32 mesh_index_size(const mesh* mesh);
+void mesh_write_indices(const mesh* mesh, void* dst);
+
+void mesh_destroy(mesh* mesh);
@@ -0,0 +1,142 @@
+#include "mesh_cache.h"
+
+static u64 align_up(u64 value, u64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+u64 mesh_cache_hash(const void* data, u64 size)
+{
+    const u8* bytes = (const u8*)data;
+    u64 hash = 0x9e3779b97f4a7c15ull ^ size;
+    u64 i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        u64 word;
+        memcpy(&word, bytes + i, sizeof(word));
+
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+
+    for (; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+static void point_streams(mesh_cache* cache, const u8* data, u64 size)
+{
+    cache->size = size;
+    cache->header = (const mesh_cache_header*)data;
+    cache->vertices = (const mesh_vertex*)(data + cache->header->vertex_offset);
+    cache->indices = data + cache->header->index_offset;
+}
+
+bool mesh_cache_open(mesh_cache* cache, const char* path, u64 source_hash, i64 source_mtime, u64 source_size)
+{
+    memset(cache, 0, sizeof(mesh_cache));
+
+    if (!file_map_open(&cache->mapping, path)) {
+        return false;
+    }
+
+    const mesh_cache_header* header = (const mesh_cache_header*)cache->mapping.data;
+    u64 size = cache->mapping.size;
+
+    bool valid = size >= sizeof(mesh_cache_header)
+        && header->magic == MESH_CACHE_MAGIC
+        && header->version == MESH_CACHE_VERSION
+        && header->source_hash == source_hash
+        && header->source_mtime == source_mtime
+        && header->source_size == source_size
+        && header->vertex_stride == sizeof(mesh_vertex)
+        && (header->index_size == 2 || header->index_size == 4)
+        && header->vertex_offset % MESH_CACHE_ALIGNMENT == 0
+        && header->index_offset % MESH_CACHE_ALIGNMENT == 0
+        && header->vertex_offset <= size && (u64)header->vertex_count * header->vertex_stride <= size - header->vertex_offset
+        && header->index_offset <= size && (u64)header->index_count * header->index_size <= size - header->index_offset;
+
+    if (!valid) {
+        mesh_cache_release(cache);
+        return false;
+    }
+
+    point_streams(cache, (const u8*)cache->mapping.data, size);
+    return true;
+}
+
+void mesh_cache_build(mesh_cache* cache, const mesh* mesh, u64 source_hash, i64 source_mtime, u64 source_size)
+{
+    memset(cache, 0, sizeof(mesh_cache));
+
+    mesh_cache_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.source_hash = source_hash;
+    header.source_mtime = source_mtime;
+    header.source_size = source_size;
+    header.vertex_stride = sizeof(mesh_vertex);
+    header.vertex_count = mesh->vertex_count;
+    header.index_count = mesh->index_count;
+    header.index_size = mesh_index_size(mesh);
+    header.vertex_offset = align_up(sizeof(mesh_cache_header), MESH_CACHE_ALIGNMENT);
+    header.index_offset = align_up(header.vertex_offset + (u64)header.vertex_count * header.vertex_stride, MESH_CACHE_ALIGNMENT);
+
+    u64 size = header.index_offset + (u64)header.index_count * header.index_size;
+
+    cache->owned = (u8*)calloc(1, size);
+    memcpy(cache->owned, &header, sizeof(header));
+    memcpy(cache->owned + header.vertex_offset, mesh->vertices, (size_t)header.vertex_count * header.vertex_stride);
+    mesh_write_indices(mesh, cache->owned + header.index_offset);
+
+    point_streams(cache, cache->owned, size);
+}
+
+bool mesh_cache_write(const mesh_cache* cache, const char* path)
+{
+    // written next to the final file and renamed over it so readers never map a torn file
+    char temporary_path[1024];
+    if (snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path) >= (int)sizeof(temporary_path)) {
+        return false;
+    }
+
+    FILE* f = fopen(temporary_path, "wb");
+    if (!f) {
+        return false;
+    }
+
+    bool written = fwrite(cache->header, 1, (size_t)cache->size, f) == cache->size;
+    written = fclose(f) == 0 && written;
+
+    if (!written) {
+        remove(temporary_path);
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename does not replace an existing file on windows
+    remove(path);
+#endif
+
+    if (rename(temporary_path, path) != 0) {
+        remove(temporary_path);
+        return false;
+    }
+
+    return true;
+}
+
+void mesh_cache_release(mesh_cache* cache)
+{
+    file_map_close(&cache->mapping);
+    free(cache->owned);
+
+    memset(cache, 0, sizeof(mesh_cache));
+}
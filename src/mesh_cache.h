@@ -0,0 +1,44 @@
+#pragma once
+
+#include "defines.h"
+#include "file_map.h"
+#include "mesh.h"
+
+#define MESH_CACHE_MAGIC 0x4853454du
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_ALIGNMENT 16
+
+// the vertex and index streams follow the header at aligned offsets, indices are stored at their final width
+typedef struct mesh_cache_header {
+    u32 magic;
+    u32 version;
+    u64 source_hash;
+    i64 source_mtime;
+    u64 source_size;
+    u32 vertex_stride;
+    u32 vertex_count;
+    u32 index_count;
+    u32 index_size;
+    u64 vertex_offset;
+    u64 index_offset;
+} mesh_cache_header;
+
+// a serialized mesh, either mapped from a cache file or built in memory
+typedef struct mesh_cache {
+    file_mapping mapping;
+    u8* owned;
+    u64 size;
+    const mesh_cache_header* header;
+    const mesh_vertex* vertices;
+    const void* indices;
+} mesh_cache;
+
+u64 mesh_cache_hash(const void* data, u64 size);
+
+// fails unless the file was written by this version from a source with the same hash, mtime and size
+bool mesh_cache_open(mesh_cache* cache, const char* path, u64 source_hash, i64 source_mtime, u64 source_size);
+
+void mesh_cache_build(mesh_cache* cache, const mesh* mesh, u64 source_hash, i64 source_mtime, u64 source_size);
+bool mesh_cache_write(const mesh_cache* cache, const char* path);
+
+void mesh_cache_release(mesh_cache* cache);
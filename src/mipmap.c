@@ -0,0 +1,151 @@
+#include "mipmap.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+u32 mipmap_level_count(u32 width, u32 height)
+{
+    u32 size = width > height ? width : height;
+    u32 levels = 1;
+
+    while (size > 1) {
+        size >>= 1;
+        ++levels;
+    }
+
+    return levels;
+}
+
+u64 mipmap_chain_size_rgba8(u32 width, u32 height, u32 levels)
+{
+    u64 size = 0;
+
+    for (u32 i = 0; i < levels; ++i) {
+        size += (u64)width * height * 4;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    return size;
+}
+
+static f32 srgb_to_linear[256];
+
+// linear value halfway between srgb codes i and i + 1, encoding picks the last code whose threshold is not above
+static f32 srgb_thresholds[255];
+
+static once_flag srgb_tables_once = ONCE_FLAG_INIT;
+
+static f32 decode_srgb(f32 value)
+{
+    return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static void build_srgb_tables(void)
+{
+    for (u32 i = 0; i < 256; ++i) {
+        srgb_to_linear[i] = decode_srgb((f32)i / 255.0f);
+    }
+
+    for (u32 i = 0; i < 255; ++i) {
+        srgb_thresholds[i] = decode_srgb(((f32)i + 0.5f) / 255.0f);
+    }
+}
+
+static u8 linear_to_srgb(f32 value)
+{
+    u32 low = 0;
+    u32 high = 255;
+
+    while (low < high) {
+        u32 mid = (low + high + 1) / 2;
+
+        if (value >= srgb_thresholds[mid - 1]) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return (u8)low;
+}
+
+#ifdef MIPMAP_SSE2
+// averages 4 source texels of two rows into 2 destination texels
+static void downsample_2_sse2(const u8* row0, const u8* row1, u8* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+
+    __m128i a = _mm_loadu_si128((const __m128i*)row0);
+    __m128i b = _mm_loadu_si128((const __m128i*)row1);
+
+    __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+    low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+    high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+
+    __m128i sum = _mm_unpacklo_epi64(low, high);
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+
+    _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(sum, sum));
+}
+#endif
+
+void mipmap_downsample_rgba8(const u8* src, u32 width, u32 height, u8* dst, bool srgb)
+{
+    if (srgb) {
+        call_once(&srgb_tables_once, build_srgb_tables);
+    }
+
+    u32 dst_width = width > 1 ? width / 2 : 1;
+    u32 dst_height = height > 1 ? height / 2 : 1;
+
+    for (u32 y = 0; y < dst_height; ++y) {
+        const u8* row0 = src + (u64)(2 * y < height ? 2 * y : height - 1) * width * 4;
+        const u8* row1 = src + (u64)(2 * y + 1 < height ? 2 * y + 1 : height - 1) * width * 4;
+        u8* out = dst + (u64)y * dst_width * 4;
+
+        u32 x = 0;
+
+#ifdef MIPMAP_SSE2
+        // the vector path averages raw bytes, which is only correct for linear data
+        for (; !srgb && 2 * x + 3 < width && x + 1 < dst_width; x += 2) {
+            downsample_2_sse2(row0 + x * 8, row1 + x * 8, out + x * 4);
+        }
+#endif
+
+        for (; x < dst_width; ++x) {
+            u32 x0 = 2 * x < width ? 2 * x : width - 1;
+            u32 x1 = 2 * x + 1 < width ? 2 * x + 1 : width - 1;
+
+            for (u32 c = 0; c < 3 && srgb; ++c) {
+                f32 sum = srgb_to_linear[row0[x0 * 4 + c]] + srgb_to_linear[row0[x1 * 4 + c]] + srgb_to_linear[row1[x0 * 4 + c]] + srgb_to_linear[row1[x1 * 4 + c]];
+                out[x * 4 + c] = linear_to_srgb(0.25f * sum);
+            }
+
+            for (u32 c = srgb ? 3 : 0; c < 4; ++c) {
+                u32 sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+                out[x * 4 + c] = (u8)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+void mipmap_generate_rgba8(u8* chain, u32 width, u32 height, u32 levels, bool srgb)
+{
+    u8* level = chain;
+
+    for (u32 i = 1; i < levels; ++i) {
+        u8* next = level + (u64)width * height * 4;
+
+        mipmap_downsample_rgba8(level, width, height, next, srgb);
+
+        level = next;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "defines.h"
+
+u32 mipmap_level_count(u32 width, u32 height);
+
+// size in bytes of an rgba8 chain with the given number of levels
+u64 mipmap_chain_size_rgba8(u32 width, u32 height, u32 levels);
+
+// 2x2 box filter, dst is max(1, width / 2) by max(1, height / 2); odd edges repeat the last texel.
+// with srgb the color channels are averaged in linear space like a linear blit of an srgb format, alpha stays linear
+void mipmap_downsample_rgba8(const u8* src, u32 width, u32 height, u8* dst, bool srgb);
+
+// fills levels 1..levels-1 of a tightly packed chain whose level 0 is already at the start of chain
+void mipmap_generate_rgba8(u8* chain, u32 width, u32 height, u32 levels, bool srgb);
@@ -0,0 +1,48 @@
+#include "scene.h"
+
+#define SCENE_FIELD_COUNT 10
+
+void scene_objects_create(scene_objects* objects, u32 capacity)
+{
+    memset(objects, 0, sizeof(scene_objects));
+
+    objects->capacity = (capacity + SCENE_BATCH_SIZE - 1) / SCENE_BATCH_SIZE * SCENE_BATCH_SIZE;
+
+    // one allocation, the padding lanes of the last batch stay zero
+    f32* fields = (f32*)calloc((u64)objects->capacity * SCENE_FIELD_COUNT, sizeof(f32));
+    if (!fields) {
+        fprintf(stderr, "failed to allocate scene objects\n");
+        objects->capacity = 0;
+        return;
+    }
+
+    f32** arrays[SCENE_FIELD_COUNT] = {
+        &objects->center_x, &objects->center_y, &objects->center_z, &objects->radius,
+        &objects->min_x, &objects->min_y, &objects->min_z,
+        &objects->max_x, &objects->max_y, &objects->max_z
+    };
+
+    for (u32 i = 0; i < SCENE_FIELD_COUNT; ++i) {
+        *arrays[i] = fields + (u64)i * objects->capacity;
+    }
+}
+
+void scene_objects_destroy(scene_objects* objects)
+{
+    free(objects->center_x);
+    memset(objects, 0, sizeof(scene_objects));
+}
+
+void scene_objects_set_bounds(scene_objects* objects, u32 index, const f32 center[3], f32 radius, const f32 min[3], const f32 max[3])
+{
+    objects->center_x[index] = center[0];
+    objects->center_y[index] = center[1];
+    objects->center_z[index] = center[2];
+    objects->radius[index] = radius;
+    objects->min_x[index] = min[0];
+    objects->min_y[index] = min[1];
+    objects->min_z[index] = min[2];
+    objects->max_x[index] = max[0];
+    objects->max_y[index] = max[1];
+    objects->max_z[index] = max[2];
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "defines.h"
+
+// objects are processed in batches of this many lanes, capacity is rounded up to it
+#define SCENE_BATCH_SIZE 8
+
+// bounds of every object as structure of arrays, so a batch of one field is a single vector load
+typedef struct scene_objects {
+    f32* center_x;
+    f32* center_y;
+    f32* center_z;
+    f32* radius;
+    f32* min_x;
+    f32* min_y;
+    f32* min_z;
+    f32* max_x;
+    f32* max_y;
+    f32* max_z;
+    u32 count;
+    u32 capacity;
+} scene_objects;
+
+void scene_objects_create(scene_objects* objects, u32 capacity);
+void scene_objects_destroy(scene_objects* objects);
+
+void scene_objects_set_bounds(scene_objects* objects, u32 index, const f32 center[3], f32 radius, const f32 min[3], const f32 max[3]);
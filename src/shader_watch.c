@@ -0,0 +1,102 @@
+#include "shader_watch.h"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+bool shader_watch_open(shader_watch* watch, const char* directory)
+{
+    watch->descriptor = -1;
+    watch->watch = -1;
+
+#if defined(__linux__)
+    watch->descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->descriptor < 0) {
+        return false;
+    }
+
+    // editors either rewrite the file in place or rename a temporary over it
+    watch->watch = inotify_add_watch(watch->descriptor, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch->watch < 0) {
+        close(watch->descriptor);
+        watch->descriptor = -1;
+        return false;
+    }
+
+    return true;
+#else
+    (void)directory;
+    return false;
+#endif
+}
+
+void shader_watch_close(shader_watch* watch)
+{
+#if defined(__linux__)
+    if (watch->descriptor >= 0) {
+        close(watch->descriptor);
+    }
+#endif
+
+    watch->descriptor = -1;
+    watch->watch = -1;
+}
+
+// names end up on a shell command line, so anything beyond [A-Za-z0-9._-] is ignored
+static bool is_shader_source(const char* name)
+{
+    for (const char* c = name; *c != '\0'; ++c) {
+        if (!isalnum((unsigned char)*c) && *c != '.' && *c != '_' && *c != '-') {
+            return false;
+        }
+    }
+
+    const char* extension = strrchr(name, '.');
+
+    return extension != NULL && (strcmp(extension, ".vert") == 0 || strcmp(extension, ".frag") == 0 || strcmp(extension, ".comp") == 0);
+}
+
+u32 shader_watch_poll(shader_watch* watch, char names[SHADER_WATCH_MAX_CHANGES][SHADER_WATCH_NAME_SIZE])
+{
+    u32 count = 0;
+
+#if defined(__linux__)
+    if (watch->descriptor < 0) {
+        return 0;
+    }
+
+    alignas(struct inotify_event) char buffer[4096];
+
+    for (;;) {
+        ssize_t size = read(watch->descriptor, buffer, sizeof(buffer));
+        if (size <= 0) {
+            break;
+        }
+
+        for (char* at = buffer; at < buffer + size;) {
+            const struct inotify_event* event = (const struct inotify_event*)at;
+            at += sizeof(struct inotify_event) + event->len;
+
+            if (event->len == 0 || !is_shader_source(event->name) || strlen(event->name) >= SHADER_WATCH_NAME_SIZE) {
+                continue;
+            }
+
+            // one save often raises several events for the same file
+            bool seen = false;
+            for (u32 i = 0; i < count && !seen; ++i) {
+                seen = strcmp(names[i], event->name) == 0;
+            }
+
+            if (!seen && count < SHADER_WATCH_MAX_CHANGES) {
+                strcpy(names[count++], event->name);
+            }
+        }
+    }
+#else
+    (void)watch;
+    (void)names;
+#endif
+
+    return count;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "defines.h"
+
+#define SHADER_WATCH_NAME_SIZE 64
+#define SHADER_WATCH_MAX_CHANGES 16
+
+// notifies about files written or moved into one directory, only implemented with inotify on linux
+typedef struct shader_watch {
+    int descriptor;
+    int watch;
+} shader_watch;
+
+bool shader_watch_open(shader_watch* watch, const char* directory);
+void shader_watch_close(shader_watch* watch);
+
+// never blocks. fills the distinct names of glsl sources (.vert, .frag, .comp) changed since the last call,
+// names with characters outside [A-Za-z0-9._-] are skipped
+u32 shader_watch_poll(shader_watch* watch, char names[SHADER_WATCH_MAX_CHANGES][SHADER_WATCH_NAME_SIZE]);
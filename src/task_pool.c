@@ -0,0 +1,113 @@
+#include "task_pool.h"
+
+static void run_tasks(task_pool* pool)
+{
+    for (;;) {
+        u32 index = atomic_fetch_add_explicit(&pool->next_task, 1, memory_order_relaxed);
+        if (index >= pool->task_count) {
+            break;
+        }
+
+        pool->fn(pool->context, index);
+    }
+}
+
+static int task_worker(void* arg)
+{
+    task_pool* pool = (task_pool*)arg;
+    u64 seen = 0;
+
+    for (;;) {
+        mtx_lock(&pool->mutex);
+        while (!pool->stop && pool->generation == seen) {
+            cnd_wait(&pool->wake, &pool->mutex);
+        }
+
+        if (pool->stop) {
+            mtx_unlock(&pool->mutex);
+            break;
+        }
+
+        seen = pool->generation;
+        mtx_unlock(&pool->mutex);
+
+        run_tasks(pool);
+
+        mtx_lock(&pool->mutex);
+        pool->active -= 1;
+        if (pool->active == 0) {
+            cnd_signal(&pool->done);
+        }
+        mtx_unlock(&pool->mutex);
+    }
+
+    return 0;
+}
+
+void task_pool_create(task_pool* pool, u32 thread_count)
+{
+    memset(pool, 0, sizeof(task_pool));
+
+    mtx_init(&pool->mutex, mtx_plain);
+    cnd_init(&pool->wake);
+    cnd_init(&pool->done);
+    atomic_init(&pool->next_task, 0);
+
+    pool->threads = thread_count > 0 ? (thrd_t*)calloc(thread_count, sizeof(thrd_t)) : NULL;
+
+    for (u32 i = 0; i < thread_count; ++i) {
+        if (thrd_create(&pool->threads[pool->thread_count], task_worker, pool) != thrd_success) {
+            fprintf(stderr, "failed to create task thread\n");
+            break;
+        }
+
+        pool->thread_count += 1;
+    }
+}
+
+void task_pool_destroy(task_pool* pool)
+{
+    mtx_lock(&pool->mutex);
+    pool->stop = true;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->mutex);
+
+    for (u32 i = 0; i < pool->thread_count; ++i) {
+        thrd_join(pool->threads[i], NULL);
+    }
+
+    free(pool->threads);
+
+    cnd_destroy(&pool->done);
+    cnd_destroy(&pool->wake);
+    mtx_destroy(&pool->mutex);
+}
+
+void task_pool_run(task_pool* pool, task_fn fn, void* context, u32 task_count)
+{
+    pool->fn = fn;
+    pool->context = context;
+    pool->task_count = task_count;
+    atomic_store_explicit(&pool->next_task, 0, memory_order_relaxed);
+
+    // a single task is not worth waking anyone for
+    if (pool->thread_count == 0 || task_count <= 1) {
+        run_tasks(pool);
+        return;
+    }
+
+    mtx_lock(&pool->mutex);
+    pool->active = pool->thread_count;
+    pool->generation += 1;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->mutex);
+
+    run_tasks(pool);
+
+    // workers must be parked again before the next run resets next_task
+    mtx_lock(&pool->mutex);
+    while (pool->active > 0) {
+        cnd_wait(&pool->done, &pool->mutex);
+    }
+    mtx_unlock(&pool->mutex);
+}
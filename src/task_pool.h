@@ -0,0 +1,27 @@
+#pragma once
+
+#include "defines.h"
+
+typedef void (*task_fn)(void* context, u32 index);
+
+// persistent workers for fork/join work issued every frame, the calling thread takes tasks as well
+typedef struct task_pool {
+    thrd_t* threads;
+    u32 thread_count;
+    mtx_t mutex;
+    cnd_t wake;
+    cnd_t done;
+    u64 generation;
+    u32 active;
+    bool stop;
+    task_fn fn;
+    void* context;
+    u32 task_count;
+    atomic_uint next_task;
+} task_pool;
+
+void task_pool_create(task_pool* pool, u32 thread_count);
+void task_pool_destroy(task_pool* pool);
+
+// runs fn(context, i) for every i below task_count and returns once all of them finished
+void task_pool_run(task_pool* pool, task_fn fn, void* context, u32 task_count);
@@ -0,0 +1,297 @@
+#include "transform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+#define TRANSFORM_FIELD_COUNT 10
+
+void transform_system_create(transform_system* system, u32 capacity, u32 slice_count)
+{
+    memset(system, 0, sizeof(transform_system));
+
+    system->capacity = (capacity + TRANSFORM_BATCH_SIZE - 1) / TRANSFORM_BATCH_SIZE * TRANSFORM_BATCH_SIZE;
+    system->slice_count = slice_count < TRANSFORM_MAX_SLICES ? slice_count : TRANSFORM_MAX_SLICES;
+
+    // the padding lanes of the last batch are computed but never written out
+    f32* fields = (f32*)calloc((u64)system->capacity * TRANSFORM_FIELD_COUNT, sizeof(f32));
+    system->parents = (u32*)calloc(system->capacity, sizeof(u32));
+    system->outputs = (u32*)calloc(system->capacity, sizeof(u32));
+    system->dirty = (u8*)calloc(system->capacity, sizeof(u8));
+    system->changed = (u8*)calloc(system->capacity, sizeof(u8));
+    system->pending = (u8*)calloc(system->capacity, sizeof(u8));
+    system->world = (f32*)calloc((u64)system->capacity * 16, sizeof(f32));
+
+    if (!fields || !system->parents || !system->outputs || !system->dirty || !system->changed || !system->pending || !system->world) {
+        fprintf(stderr, "failed to allocate transform system\n");
+        free(fields);
+        transform_system_destroy(system);
+        return;
+    }
+
+    f32** arrays[TRANSFORM_FIELD_COUNT] = {
+        &system->translation_x, &system->translation_y, &system->translation_z,
+        &system->rotation_x, &system->rotation_y, &system->rotation_z, &system->rotation_w,
+        &system->scale_x, &system->scale_y, &system->scale_z
+    };
+
+    for (u32 i = 0; i < TRANSFORM_FIELD_COUNT; ++i) {
+        *arrays[i] = fields + (u64)i * system->capacity;
+    }
+}
+
+void transform_system_destroy(transform_system* system)
+{
+    free(system->translation_x);
+    free(system->parents);
+    free(system->outputs);
+    free(system->dirty);
+    free(system->changed);
+    free(system->pending);
+    free(system->world);
+
+    memset(system, 0, sizeof(transform_system));
+}
+
+u32 transform_add(transform_system* system, u32 parent, u32 output)
+{
+    if (system->count == system->capacity || (parent != TRANSFORM_NO_PARENT && parent >= system->count)) {
+        fprintf(stderr, "failed to add transform node\n");
+        return TRANSFORM_NO_PARENT;
+    }
+
+    u32 node = system->count++;
+
+    system->rotation_w[node] = 1.0f;
+    system->scale_x[node] = 1.0f;
+    system->scale_y[node] = 1.0f;
+    system->scale_z[node] = 1.0f;
+    system->parents[node] = parent;
+    system->outputs[node] = output;
+    system->dirty[node] = 1;
+
+    return node;
+}
+
+void transform_set_translation(transform_system* system, u32 node, const f32 translation[3])
+{
+    system->translation_x[node] = translation[0];
+    system->translation_y[node] = translation[1];
+    system->translation_z[node] = translation[2];
+    system->dirty[node] = 1;
+}
+
+void transform_set_rotation(transform_system* system, u32 node, const f32 rotation[4])
+{
+    system->rotation_x[node] = rotation[0];
+    system->rotation_y[node] = rotation[1];
+    system->rotation_z[node] = rotation[2];
+    system->rotation_w[node] = rotation[3];
+    system->dirty[node] = 1;
+}
+
+void transform_set_scale(transform_system* system, u32 node, const f32 scale[3])
+{
+    system->scale_x[node] = scale[0];
+    system->scale_y[node] = scale[1];
+    system->scale_z[node] = scale[2];
+    system->dirty[node] = 1;
+}
+
+// local matrices of one batch, one column-major matrix per lane
+#ifdef TRANSFORM_SSE2
+static void build_batch(const transform_system* system, u32 base, f32 local[TRANSFORM_BATCH_SIZE][16])
+{
+    __m128 x = _mm_loadu_ps(system->rotation_x + base);
+    __m128 y = _mm_loadu_ps(system->rotation_y + base);
+    __m128 z = _mm_loadu_ps(system->rotation_z + base);
+    __m128 w = _mm_loadu_ps(system->rotation_w + base);
+    __m128 sx = _mm_loadu_ps(system->scale_x + base);
+    __m128 sy = _mm_loadu_ps(system->scale_y + base);
+    __m128 sz = _mm_loadu_ps(system->scale_z + base);
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+
+    __m128 xx = _mm_mul_ps(x, x);
+    __m128 yy = _mm_mul_ps(y, y);
+    __m128 zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y);
+    __m128 xz = _mm_mul_ps(x, z);
+    __m128 yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x);
+    __m128 wy = _mm_mul_ps(w, y);
+    __m128 wz = _mm_mul_ps(w, z);
+
+    // rows of the three scaled rotation columns, one lane per node
+    __m128 c0[4] = {
+        _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+        _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+        _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+        _mm_setzero_ps()
+    };
+    __m128 c1[4] = {
+        _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+        _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+        _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+        _mm_setzero_ps()
+    };
+    __m128 c2[4] = {
+        _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+        _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+        _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+        _mm_setzero_ps()
+    };
+    __m128 c3[4] = {
+        _mm_loadu_ps(system->translation_x + base),
+        _mm_loadu_ps(system->translation_y + base),
+        _mm_loadu_ps(system->translation_z + base),
+        one
+    };
+
+    // transposing each column turns lanes back into nodes
+    __m128* columns[4] = {c0, c1, c2, c3};
+    for (u32 c = 0; c < 4; ++c) {
+        __m128* rows = columns[c];
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+
+        for (u32 lane = 0; lane < TRANSFORM_BATCH_SIZE; ++lane) {
+            _mm_storeu_ps(local[lane] + c * 4, rows[lane]);
+        }
+    }
+}
+
+// out = parent * local, all column-major
+static void multiply(const f32* parent, const f32* local, f32* out)
+{
+    __m128 p0 = _mm_loadu_ps(parent);
+    __m128 p1 = _mm_loadu_ps(parent + 4);
+    __m128 p2 = _mm_loadu_ps(parent + 8);
+    __m128 p3 = _mm_loadu_ps(parent + 12);
+
+    for (u32 c = 0; c < 4; ++c) {
+        __m128 column = _mm_mul_ps(p0, _mm_set1_ps(local[c * 4]));
+        column = _mm_add_ps(column, _mm_mul_ps(p1, _mm_set1_ps(local[c * 4 + 1])));
+        column = _mm_add_ps(column, _mm_mul_ps(p2, _mm_set1_ps(local[c * 4 + 2])));
+        column = _mm_add_ps(column, _mm_mul_ps(p3, _mm_set1_ps(local[c * 4 + 3])));
+        _mm_storeu_ps(out + c * 4, column);
+    }
+}
+
+static void store_matrix(void* dst, const f32* matrix)
+{
+    f32* out = (f32*)dst;
+
+    _mm_storeu_ps(out, _mm_loadu_ps(matrix));
+    _mm_storeu_ps(out + 4, _mm_loadu_ps(matrix + 4));
+    _mm_storeu_ps(out + 8, _mm_loadu_ps(matrix + 8));
+    _mm_storeu_ps(out + 12, _mm_loadu_ps(matrix + 12));
+}
+#else
+static void build_batch(const transform_system* system, u32 base, f32 local[TRANSFORM_BATCH_SIZE][16])
+{
+    for (u32 lane = 0; lane < TRANSFORM_BATCH_SIZE; ++lane) {
+        u32 i = base + lane;
+
+        f32 x = system->rotation_x[i];
+        f32 y = system->rotation_y[i];
+        f32 z = system->rotation_z[i];
+        f32 w = system->rotation_w[i];
+        f32 sx = system->scale_x[i];
+        f32 sy = system->scale_y[i];
+        f32 sz = system->scale_z[i];
+
+        f32* m = local[lane];
+
+        m[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+        m[1] = 2.0f * (x * y + w * z) * sx;
+        m[2] = 2.0f * (x * z - w * y) * sx;
+        m[3] = 0.0f;
+        m[4] = 2.0f * (x * y - w * z) * sy;
+        m[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+        m[6] = 2.0f * (y * z + w * x) * sy;
+        m[7] = 0.0f;
+        m[8] = 2.0f * (x * z + w * y) * sz;
+        m[9] = 2.0f * (y * z - w * x) * sz;
+        m[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+        m[11] = 0.0f;
+        m[12] = system->translation_x[i];
+        m[13] = system->translation_y[i];
+        m[14] = system->translation_z[i];
+        m[15] = 1.0f;
+    }
+}
+
+static void multiply(const f32* parent, const f32* local, f32* out)
+{
+    for (u32 c = 0; c < 4; ++c) {
+        for (u32 r = 0; r < 4; ++r) {
+            out[c * 4 + r] = parent[r] * local[c * 4] + parent[4 + r] * local[c * 4 + 1] + parent[8 + r] * local[c * 4 + 2] + parent[12 + r] * local[c * 4 + 3];
+        }
+    }
+}
+
+static void store_matrix(void* dst, const f32* matrix)
+{
+    memcpy(dst, matrix, 16 * sizeof(f32));
+}
+#endif
+
+u32 transform_system_update(transform_system* system, u32 slice, void* dst, u64 stride)
+{
+    u8 all_slices = (u8)((1u << system->slice_count) - 1);
+    u8 slice_bit = (u8)(1u << slice);
+    u32 written = 0;
+
+    for (u32 base = 0; base < system->count; base += TRANSFORM_BATCH_SIZE) {
+        u32 end = base + TRANSFORM_BATCH_SIZE < system->count ? base + TRANSFORM_BATCH_SIZE : system->count;
+        bool recompute = false;
+        bool write = false;
+
+        for (u32 i = base; i < end; ++i) {
+            u32 parent = system->parents[i];
+            system->changed[i] = system->dirty[i] | (parent != TRANSFORM_NO_PARENT ? system->changed[parent] : 0);
+
+            recompute |= system->changed[i] != 0;
+            write |= system->changed[i] || (system->pending[i] & slice_bit);
+        }
+
+        // untouched batches cost a flag scan
+        if (!write) {
+            continue;
+        }
+
+        f32 local[TRANSFORM_BATCH_SIZE][16];
+        if (recompute) {
+            build_batch(system, base, local);
+        }
+
+        for (u32 i = base; i < end; ++i) {
+            f32* world = system->world + (u64)i * 16;
+
+            if (system->changed[i]) {
+                u32 parent = system->parents[i];
+
+                // a parent in the same batch has already been finished above
+                if (parent == TRANSFORM_NO_PARENT) {
+                    memcpy(world, local[i - base], sizeof(local[0]));
+                } else {
+                    multiply(system->world + (u64)parent * 16, local[i - base], world);
+                }
+
+                system->dirty[i] = 0;
+                system->pending[i] = all_slices;
+            }
+
+            if ((system->pending[i] & slice_bit) && system->outputs[i] != TRANSFORM_NO_OUTPUT) {
+                store_matrix((u8*)dst + system->outputs[i] * stride, world);
+                written += 1;
+            }
+
+            system->pending[i] &= (u8)~slice_bit;
+        }
+    }
+
+    return written;
+}
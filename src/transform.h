@@ -0,0 +1,53 @@
+#pragma once
+
+#include "defines.h"
+
+// local transforms are turned into matrices this many nodes at a time
+#define TRANSFORM_BATCH_SIZE 4
+#define TRANSFORM_MAX_SLICES 8
+
+#define TRANSFORM_NO_PARENT UINT32_MAX
+#define TRANSFORM_NO_OUTPUT UINT32_MAX
+
+// translation, rotation (quaternion) and scale of every node as structure of arrays.
+// parents always precede their children, so one forward pass resolves the hierarchy
+typedef struct transform_system {
+    f32* translation_x;
+    f32* translation_y;
+    f32* translation_z;
+    f32* rotation_x;
+    f32* rotation_y;
+    f32* rotation_z;
+    f32* rotation_w;
+    f32* scale_x;
+    f32* scale_y;
+    f32* scale_z;
+    u32* parents;
+    u32* outputs;
+    // local transform changed since the last update
+    u8* dirty;
+    // world matrix recomputed by the last update
+    u8* changed;
+    // bit s is set until the current world matrix has been written to output slice s
+    u8* pending;
+    // column-major world matrices, 16 floats per node, kept for children and readback
+    f32* world;
+    u32 count;
+    u32 capacity;
+    u32 slice_count;
+} transform_system;
+
+// slice_count is the number of output copies that are updated round robin, one per frame in flight
+void transform_system_create(transform_system* system, u32 capacity, u32 slice_count);
+void transform_system_destroy(transform_system* system);
+
+// identity node; output is the element index the world matrix is written to, or TRANSFORM_NO_OUTPUT
+u32 transform_add(transform_system* system, u32 parent, u32 output);
+
+void transform_set_translation(transform_system* system, u32 node, const f32 translation[3]);
+void transform_set_rotation(transform_system* system, u32 node, const f32 rotation[4]);
+void transform_set_scale(transform_system* system, u32 node, const f32 scale[3]);
+
+// recomputes the world matrices of dirty nodes and their descendants, and writes every matrix that slice
+// has not seen yet straight to dst + output * stride. returns the number of matrices written
+u32 transform_system_update(transform_system* system, u32 slice, void* dst, u64 stride);